@@ -4,6 +4,8 @@
 #include <lauxlib.h>
 
 #include "malloc_hook.h"
+#include "skynet_timer.h"
+#include "skynet_socket.h"
 
 static int
 ltotal(lua_State *L) {
@@ -92,6 +94,42 @@ lprofactive(lua_State *L) {
 	return 1;
 }
 
+static int
+ltimerpool(lua_State *L) {
+	struct timer_pool_stat stat;
+	skynet_timer_poolstat(&stat);
+	lua_createtable(L, 0, 5);
+	lua_pushinteger(L, (lua_Integer)stat.node);
+	lua_setfield(L, -2, "node");
+	lua_pushinteger(L, (lua_Integer)stat.free);
+	lua_setfield(L, -2, "free");
+	lua_pushinteger(L, (lua_Integer)stat.reuse);
+	lua_setfield(L, -2, "reuse");
+	lua_pushinteger(L, (lua_Integer)stat.release);
+	lua_setfield(L, -2, "release");
+	lua_pushinteger(L, (lua_Integer)stat.bytes);
+	lua_setfield(L, -2, "bytes");
+	return 1;
+}
+
+static int
+lsocketpool(lua_State *L) {
+	struct socket_pool_stat stat;
+	skynet_socket_poolstat(&stat);
+	lua_createtable(L, 0, 5);
+	lua_pushinteger(L, (lua_Integer)stat.buffer);
+	lua_setfield(L, -2, "buffer");
+	lua_pushinteger(L, (lua_Integer)stat.free);
+	lua_setfield(L, -2, "free");
+	lua_pushinteger(L, (lua_Integer)stat.reuse);
+	lua_setfield(L, -2, "reuse");
+	lua_pushinteger(L, (lua_Integer)stat.release);
+	lua_setfield(L, -2, "release");
+	lua_pushinteger(L, (lua_Integer)stat.bytes);
+	lua_setfield(L, -2, "bytes");
+	return 1;
+}
+
 LUAMOD_API int
 luaopen_skynet_memory(lua_State *L) {
 	luaL_checkversion(L);
@@ -107,6 +145,8 @@ luaopen_skynet_memory(lua_State *L) {
 		{ "current", lcurrent },
 		{ "dumpheap", ldumpheap },
 		{ "profactive", lprofactive },
+		{ "timerpool", ltimerpool },
+		{ "socketpool", lsocketpool },
 		{ NULL, NULL },
 	};
 
@@ -1,6 +1,8 @@
 #define LUA_LIB
 
 #include "skynet.h"
+#include "skynet_server.h"
+#include "skynet_timer.h"
 #include "lua-seri.h"
 
 #define KNRM  "\x1B[0m"
@@ -135,6 +137,10 @@ lcallback(lua_State *L) {
 	lua_xmove(L, cb_ctx->L, 1);
 
 	skynet_callback(context, cb_ctx, (forward)?(_forward_pre):(_cb_pre));
+	if (!forward) {
+		// msg is a lightuserdata only valid in the callback, so the small message can be inline.
+		skynet_callback_inline(context, 1);
+	}
 	return 0;
 }
 
@@ -188,6 +194,14 @@ laddresscommand(lua_State *L) {
 	return 0;
 }
 
+static int
+ltimeout_cancel(lua_State *L) {
+	struct skynet_context * context = lua_touserdata(L, lua_upvalueindex(1));
+	int session = (int)luaL_checkinteger(L, 1);
+	lua_pushboolean(L, skynet_timeout_cancel(skynet_context_handle(context), session));
+	return 1;
+}
+
 static int
 lintcommand(lua_State *L) {
 	struct skynet_context * context = lua_touserdata(L, lua_upvalueindex(1));
@@ -318,6 +332,50 @@ lsend(lua_State *L) {
 	return send_message(L, 0, 2);
 }
 
+/*
+	table addresses (integer handles)
+	integer type
+	string message
+	 lightuserdata message_ptr
+	 integer len
+ */
+static int
+lsendmulti(lua_State *L) {
+	struct skynet_context * context = lua_touserdata(L, lua_upvalueindex(1));
+	luaL_checktype(L, 1, LUA_TTABLE);
+	int type = luaL_checkinteger(L, 2);
+	int n = lua_rawlen(L, 1);
+	uint32_t * dest = lua_newuserdatauv(L, n * sizeof(uint32_t), 0);
+	int i;
+	for (i=0;i<n;i++) {
+		lua_rawgeti(L, 1, i+1);
+		dest[i] = (uint32_t)luaL_checkinteger(L, -1);
+		lua_pop(L, 1);
+	}
+	void * msg;
+	size_t sz;
+	switch (lua_type(L, 3)) {
+	case LUA_TSTRING:
+		msg = (void *)lua_tolstring(L, 3, &sz);
+		break;
+	case LUA_TLIGHTUSERDATA:
+		msg = lua_touserdata(L, 3);
+		sz = luaL_checkinteger(L, 4);
+		type |= PTYPE_TAG_DONTCOPY;
+		break;
+	default:
+		return luaL_error(L, "invalid param %s", lua_typename(L, lua_type(L,3)));
+	}
+	int count = skynet_sendmulti(context, dest, n, type, msg, sz);
+	if (count < 0) {
+		// package is too large
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	lua_pushinteger(L, count);
+	return 1;
+}
+
 /*
 	uint32 address
 	 string address
@@ -501,10 +559,12 @@ luaopen_skynet_core(lua_State *L) {
 
 	luaL_Reg l[] = {
 		{ "send" , lsend },
+		{ "sendmulti" , lsendmulti },
 		{ "genid", lgenid },
 		{ "redirect", lredirect },
 		{ "command" , lcommand },
 		{ "intcommand", lintcommand },
+		{ "timeout_cancel", ltimeout_cancel },
 		{ "addresscommand", laddresscommand },
 		{ "error", lerror },
 		{ "harbor", lharbor },
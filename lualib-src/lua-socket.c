@@ -48,7 +48,7 @@ lfreepool(lua_State *L) {
 	for (i=0;i<sz;i++) {
 		struct buffer_node *node = &pool[i];
 		if (node->msg) {
-			skynet_free(node->msg);
+			skynet_socket_freebuffer(node->msg, node->sz);
 			node->msg = NULL;
 		}
 	}
@@ -165,7 +165,7 @@ return_free_node(lua_State *L, int pool, struct socket_buffer *sb) {
 	lua_rawgeti(L,pool,1);
 	free_node->next = lua_touserdata(L,-1);
 	lua_pop(L,1);
-	skynet_free(free_node->msg);
+	skynet_socket_freebuffer(free_node->msg, free_node->sz);
 	free_node->msg = NULL;
 
 	free_node->sz = 0;
@@ -505,8 +505,14 @@ llisten(lua_State *L) {
 	int port = 0;
 	const char * host = address_port(L, tmp, addr, 2, &port);
 	int backlog = luaL_optinteger(L,3,BACKLOG);
+	int reuseport = lua_toboolean(L,4);
 	struct skynet_context * ctx = lua_touserdata(L, lua_upvalueindex(1));
-	int id = skynet_socket_listen(ctx, host,port,backlog);
+	int id;
+	if (reuseport) {
+		id = skynet_socket_reuseport_listen(ctx, host,port,backlog);
+	} else {
+		id = skynet_socket_listen(ctx, host,port,backlog);
+	}
 	if (id < 0) {
 		return luaL_error(L, "Listen error");
 	}
@@ -65,6 +65,17 @@ local unresponse = {}
 
 local wakeup_queue = {}
 local sleep_session = {}
+local timer_session = {}	-- the sessions of sleep and timeout, they can be canceled
+
+-- Remove the timer of the session. If it has fired, keep the "BREAK" tombstone until its response comes.
+local function cancel_timer(session)
+	timer_session[session] = nil
+	if c.timeout_cancel(session) then
+		session_id_coroutine[session] = nil
+	else
+		session_id_coroutine[session] = "BREAK"
+	end
+end
 
 local watching_session = {}
 local error_queue = {}
@@ -134,8 +145,8 @@ do ---- avoid session rewind conflict
 		return session
 	end
 
-	local function auxtimeout_checkconflict(timeout)
-		local session = cintcommand("TIMEOUT", timeout)
+	local function auxtimeout_checkconflict(timeout, cmd)
+		local session = cintcommand(cmd or "TIMEOUT", timeout)
 		checkconflict(session)
 		return session
 	end
@@ -155,8 +166,8 @@ do ---- avoid session rewind conflict
 		return session
 	end
 
-	local function auxtimeout_checkrewind(timeout)
-		local session = cintcommand("TIMEOUT", timeout)
+	local function auxtimeout_checkrewind(timeout, cmd)
+		local session = cintcommand(cmd or "TIMEOUT", timeout)
 		if session and session > dangerzone_low and session <= dangerzone_up then
 			-- enter dangerzone
 			set_checkconflict(session)
@@ -296,7 +307,10 @@ do ---- request/select
 			self._request = 0
 		end
 		if self._timeout then
-			session_id_coroutine[self._timeout] = "BREAK"
+			if timer_session[self._timeout] then
+				-- not timeout yet
+				cancel_timer(self._timeout)
+			end
 			self._timeout = nil
 		end
 	end
@@ -311,6 +325,7 @@ do ---- request/select
 		if timeout then
 			self._timeout = auxtimeout(timeout)
 			session_id_coroutine[self._timeout] = self._thread
+			timer_session[self._timeout] = true
 		end
 
 		local running = running_thread
@@ -493,15 +508,24 @@ end
 
 skynet.trace_timeout(false)	-- turn off by default
 
-function skynet.timeout(ti, func)
-	local session = auxtimeout(ti)
+local function timeout(session, ti, func)
 	assert(session)
 	local co = co_create_for_timeout(func, ti)
 	assert(session_id_coroutine[session] == nil)
 	session_id_coroutine[session] = co
+	timer_session[session] = true
 	return co	-- for debug
 end
 
+function skynet.timeout(ti, func)
+	return timeout(auxtimeout(ti), ti, func)
+end
+
+-- accurate to the timer_resolution in config (10ms by default)
+function skynet.timeout_ms(ms, func)
+	return timeout(auxtimeout(ms, "TIMEOUTMS"), ms, func)
+end
+
 local function suspend_sleep(session, token)
 	local tag = session_coroutine_tracetag[running_thread]
 	if tag then c.trace(tag, "sleep", 2) end
@@ -512,22 +536,32 @@ local function suspend_sleep(session, token)
 	return coroutine_yield "SUSPEND"
 end
 
-function skynet.sleep(ti, token)
-	local session = auxtimeout(ti)
+local function sleep(session, token)
 	assert(session)
 	token = token or coroutine.running()
+	timer_session[session] = true
 	local succ, ret = suspend_sleep(session, token)
 	sleep_session[token] = nil
 	if succ then
 		return
 	end
 	if ret == "BREAK" then
+		-- woken up before the timer (see dispatch_wakeup)
+		cancel_timer(session)
 		return "BREAK"
 	else
 		error(ret)
 	end
 end
 
+function skynet.sleep(ti, token)
+	return sleep(auxtimeout(ti), token)
+end
+
+function skynet.sleep_ms(ms, token)
+	return sleep(auxtimeout(ms, "TIMEOUTMS"), token)
+end
+
 function skynet.yield()
 	return skynet.sleep(0)
 end
@@ -585,6 +619,8 @@ function skynet.killthread(thread)
 	if watching_session[session] then
 		session_id_coroutine[session] = "BREAK"
 		watching_session[session] = nil
+	elseif timer_session[session] then
+		cancel_timer(session)
 	else
 		session_id_coroutine[session] = nil
 	end
@@ -694,6 +730,12 @@ function skynet.send(addr, typename, ...)
 	return c.send(addr, p.id, 0 , p.pack(...))
 end
 
+-- send one message to a list of service addresses (integer), the message is packed and allocated once.
+function skynet.sendmulti(addrs, typename, ...)
+	local p = proto[typename]
+	return c.sendmulti(addrs, p.id, p.pack(...))
+end
+
 function skynet.rawsend(addr, typename, msg, sz)
 	local p = proto[typename]
 	return c.send(addr, p.id, 0 , msg, sz)
@@ -901,6 +943,10 @@ local trace_source = {}
 local function raw_dispatch_message(prototype, msg, sz, session, source)
 	-- skynet.PTYPE_RESPONSE = 1, read skynet.h
 	if prototype == 1 then
+		if source == 0 then
+			-- the timer responds once for each session
+			timer_session[session] = nil
+		end
 		local co = session_id_coroutine[session]
 		if co == "BREAK" then
 			session_id_coroutine[session] = nil
@@ -988,7 +1034,11 @@ function skynet.dispatch_message(...)
 	assert(succ, tostring(err))
 end
 
+-- skynet.newservice([options,] name, ...) , options see skynet.launch
 function skynet.newservice(name, ...)
+	if type(name) == "table" then
+		return skynet.call(".launcher", "lua" , "LAUNCH", name, "snlua", ...)
+	end
 	return skynet.call(".launcher", "lua" , "LAUNCH", "snlua", name, ...)
 end
 
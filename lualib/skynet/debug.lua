@@ -41,6 +41,15 @@ local function init(skynet, export)
 			stat.mqlen = skynet.stat "mqlen"
 			stat.cpu = skynet.stat "cpu"
 			stat.message = skynet.stat "message"
+			if skynet.stat "latency" == 1 then
+				-- build with USE_LATENCY_STAT , in microsec
+				local function latency(what)
+					return string.format("p50 %dus p99 %dus max %dus",
+						skynet.stat(what .. " 50"), skynet.stat(what .. " 99"), skynet.stat(what .. " 100"))
+				end
+				stat.wait = latency "wait"
+				stat.handle = latency "handle"
+			end
 			skynet.ret(skynet.pack(stat))
 		end
 
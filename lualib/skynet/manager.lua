@@ -13,13 +13,35 @@ local function number_address(name)
 	end
 end
 
+-- skynet.launch([options,] service, ...) , options can be { priority = "high"|"normal"|"low" }
 function skynet.launch(...)
-	local addr = c.command("LAUNCH", table.concat({...}," "))
+	local options
+	if type((...)) == "table" then
+		options = ...
+	end
+	local param = table.concat({select(options and 2 or 1, ...)}," ")
+	if options and options.priority then
+		-- the queue is created with the priority, before the first message is scheduled
+		param = "-" .. options.priority .. " " .. param
+	end
+	local addr = c.command("LAUNCH", param)
 	if addr then
 		return tonumber(string.sub(addr , 2), 16)
 	end
 end
 
+-- skynet.priority([address,] [level]) , returns the priority of the service
+function skynet.priority(addr, level)
+	if addr and level == nil and type(addr) == "string" and not addr:find "^[:%.]" then
+		addr, level = nil, addr
+	end
+	local param = addr and skynet.address(addr) or ""
+	if level then
+		param = param .. " " .. level
+	end
+	return c.command("PRIORITY", param)
+end
+
 function skynet.kill(name)
 	local addr = number_address(name)
 	if addr then
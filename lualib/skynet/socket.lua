@@ -406,8 +406,10 @@ function socket.disconnected(id)
 	end
 end
 
-function socket.listen(host, port, backlog)
-	local id = driver.listen(host, port, backlog)
+-- When reuseport is true, the services listen on the same port (SO_REUSEPORT) as a group,
+-- and the kernel spreads the incoming connections among them.
+function socket.listen(host, port, backlog, reuseport)
+	local id = driver.listen(host, port, backlog, reuseport)
 	local s = {
 		id = id,
 		connected = false,
@@ -43,7 +43,8 @@ function gateserver.start(handler)
 		maxclient = conf.maxclient or 1024
 		nodelay = conf.nodelay
 		skynet.error("Listen on", address, port)
-		socket = socketdriver.listen(address, port, conf.backlog)
+		-- conf.reuseport : the gates listen on the same port as a group
+		socket = socketdriver.listen(address, port, conf.backlog, conf.reuseport)
 		listen_context.co = coroutine.running()
 		listen_context.fd = socket
 		skynet.wait(listen_context.co)
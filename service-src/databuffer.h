@@ -54,7 +54,8 @@ _return_message(struct databuffer *db, struct messagepool *mp) {
 	} else {
 		db->head = m->next;
 	}
-	skynet_free(m->buffer);
+	// the buffer of socket data message
+	skynet_socket_freebuffer(m->buffer, m->size);
 	m->buffer = NULL;
 	m->size = 0;
 	m->next = mp->freelist;
@@ -225,7 +225,7 @@ dispatch_socket_message(struct gate *g, const struct skynet_socket_message * mes
 		} else {
 			skynet_error(ctx, "Drop unknown connection %d message", message->id);
 			skynet_socket_close(ctx, message->id);
-			skynet_free(message->buffer);
+			skynet_socket_freebuffer(message->buffer, message->ud);
 		}
 		break;
 	}
@@ -312,7 +312,7 @@ _cb(struct skynet_context * ctx, void * ud, int type, int session, uint32_t sour
 }
 
 static int
-start_listen(struct gate *g, char * listen_addr) {
+start_listen(struct gate *g, char * listen_addr, int reuseport) {
 	struct skynet_context * ctx = g->ctx;
 	char * portstr = strrchr(listen_addr,':');
 	const char * host = "";
@@ -332,7 +332,12 @@ start_listen(struct gate *g, char * listen_addr) {
 		portstr[0] = '\0';
 		host = listen_addr;
 	}
-	g->listen_id = skynet_socket_listen(ctx, host, port, BACKLOG);
+	if (reuseport) {
+		// one member of the gates listening on the same port
+		g->listen_id = skynet_socket_reuseport_listen(ctx, host, port, BACKLOG);
+	} else {
+		g->listen_id = skynet_socket_listen(ctx, host, port, BACKLOG);
+	}
 	if (g->listen_id < 0) {
 		return 1;
 	}
@@ -350,7 +355,9 @@ gate_init(struct gate *g , struct skynet_context * ctx, char * parm) {
 	char binding[sz];
 	int client_tag = 0;
 	char header;
-	int n = sscanf(parm, "%c %s %s %d %d", &header, watchdog, binding, &client_tag, &max);
+	int reuseport = 0;
+	// header watchdog binding client_tag max [reuseport]
+	int n = sscanf(parm, "%c %s %s %d %d %d", &header, watchdog, binding, &client_tag, &max, &reuseport);
 	if (n<4) {
 		skynet_error(ctx, "Invalid gate parm %s",parm);
 		return 1;
@@ -393,5 +400,5 @@ gate_init(struct gate *g , struct skynet_context * ctx, char * parm) {
 
 	skynet_callback(ctx,g,_cb);
 
-	return start_listen(g,binding);
+	return start_listen(g,binding,reuseport);
 }
@@ -368,6 +368,10 @@ function COMMAND.cmem()
 	end
 	tmp.total = memory.total()
 	tmp.block = memory.block()
+	local pool = memory.timerpool()
+	tmp.timerpool = string.format("%d bytes, %d/%d nodes free", pool.bytes, pool.free, pool.node)
+	pool = memory.socketpool()
+	tmp.socketpool = string.format("%d bytes, %d/%d buffers free", pool.bytes, pool.free, pool.buffer)
 
 	return tmp
 end
@@ -90,9 +90,14 @@ function command.REMOVE(_, handle, kill)
 	return NORET
 end
 
-local function launch_service(service, ...)
+local function launch_service(options, service, ...)
 	local param = table.concat({...}, " ")
-	local inst = skynet.launch(service, param)
+	local inst
+	if options then
+		inst = skynet.launch(options, service, param)
+	else
+		inst = skynet.launch(service, param)
+	end
 	local session = skynet.context()
 	local response = skynet.response()
 	if inst then
@@ -107,12 +112,17 @@ local function launch_service(service, ...)
 end
 
 function command.LAUNCH(_, service, ...)
-	launch_service(service, ...)
+	if type(service) == "table" then
+		-- launch options, see skynet.launch
+		launch_service(service, ...)
+	else
+		launch_service(nil, service, ...)
+	end
 	return NORET
 end
 
 function command.LOGLAUNCH(_, service, ...)
-	local inst = launch_service(service, ...)
+	local inst = launch_service(nil, service, ...)
 	if inst then
 		core.command("LOGON", skynet.address(inst))
 	end
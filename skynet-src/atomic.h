@@ -22,6 +22,7 @@
 #define ATOM_FADD(ptr,n) __sync_fetch_and_add(ptr, n)
 #define ATOM_FSUB(ptr,n) __sync_fetch_and_sub(ptr, n)
 #define ATOM_FAND(ptr,n) __sync_fetch_and_and(ptr, n)
+#define ATOM_FENCE() __sync_synchronize()
 
 #else
 
@@ -68,6 +69,7 @@ ATOM_CAS_POINTER(STD_ atomic_uintptr_t *ptr, uintptr_t oval, uintptr_t nval) {
 #define ATOM_FADD(ptr,n) STD_ atomic_fetch_add(ptr, atomic_value_type_(ptr, n))
 #define ATOM_FSUB(ptr,n) STD_ atomic_fetch_sub(ptr, atomic_value_type_(ptr, n))
 #define ATOM_FAND(ptr,n) STD_ atomic_fetch_and(ptr, atomic_value_type_(ptr, n))
+#define ATOM_FENCE() STD_ atomic_thread_fence(STD_ memory_order_seq_cst)
 
 #endif
 
@@ -23,6 +23,8 @@
 
 #define PTYPE_TAG_DONTCOPY 0x10000
 #define PTYPE_TAG_ALLOCSESSION 0x20000
+// msg is allocated by skynet_shared_new(), the receiver shares it (read only) instead of a copy
+#define PTYPE_TAG_SHARED 0x40000
 
 struct skynet_context;
 
@@ -31,11 +33,21 @@ const char * skynet_command(struct skynet_context * context, const char * cmd ,
 uint32_t skynet_queryname(struct skynet_context * context, const char * name);
 int skynet_send(struct skynet_context * context, uint32_t source, uint32_t destination , int type, int session, void * msg, size_t sz);
 int skynet_sendname(struct skynet_context * context, uint32_t source, const char * destination , int type, int session, void * msg, size_t sz);
+// send one message to n destinations (session is 0), the data is allocated once. returns the number of messages sent
+int skynet_sendmulti(struct skynet_context * context, const uint32_t *destinations, int n, int type, void * msg, size_t sz);
+
+// refcounted message buffer (the reference count is 1 after new) for PTYPE_TAG_SHARED
+void * skynet_shared_new(size_t sz);
+void skynet_shared_release(void * msg);
 
 int skynet_isremote(struct skynet_context *, uint32_t handle, int * harbor);
 
 typedef int (*skynet_cb)(struct skynet_context * context, void *ud, int type, int session, uint32_t source , const void * msg, size_t sz);
 void skynet_callback(struct skynet_context * context, void *ud, skynet_cb cb);
+// The callback never keeps msg (returns 0), so the small message can be delivered inline without malloc,
+// and the PTYPE_TAG_SHARED message can be delivered without copy.
+// skynet_callback() turns it off.
+void skynet_callback_inline(struct skynet_context * context, int enable);
 
 uint32_t skynet_current_handle(void);
 uint64_t skynet_now(void);
@@ -0,0 +1,102 @@
+#define _GNU_SOURCE
+
+#include "skynet_affinity.h"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+int
+skynet_affinity_cpucount(void) {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+}
+
+int
+skynet_affinity_parse(const char *list, int *cpus, int max) {
+	int n = 0;
+	const char *p = list;
+	for (;;) {
+		while (isspace((unsigned char)*p))
+			++p;
+		char *end;
+		long from = strtol(p, &end, 10);
+		if (end == p || from < 0)
+			return -1;
+		long to = from;
+		p = end;
+		if (*p == '-') {
+			++p;
+			to = strtol(p, &end, 10);
+			if (end == p || to < from)
+				return -1;
+			p = end;
+		}
+		long i;
+		for (i=from;i<=to;i++) {
+			if (n >= max || i >= max)
+				return -1;
+			cpus[n++] = (int)i;
+		}
+		while (isspace((unsigned char)*p))
+			++p;
+		if (*p == '\0')
+			return n;
+		if (*p != ',')
+			return -1;
+		++p;
+	}
+}
+
+static size_t
+page_size(size_t sz) {
+	long page = sysconf(_SC_PAGESIZE);
+	if (page <= 0)
+		page = 4096;
+	return (sz + page - 1) / page * page;
+}
+
+void *
+skynet_affinity_alloc(size_t sz) {
+	sz = page_size(sz);
+	void * ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	// the pages are not mapped until they are written
+	memset(ptr, 0, sz);
+	return ptr;
+}
+
+void
+skynet_affinity_free(void *ptr, size_t sz) {
+	if (ptr)
+		munmap(ptr, page_size(sz));
+}
+
+#if defined(__linux__)
+
+int
+skynet_affinity_bind(int cpu) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+#else
+
+// Thread affinity is only supported on linux now.
+int
+skynet_affinity_bind(int cpu) {
+	(void)cpu;
+	return -1;
+}
+
+#endif
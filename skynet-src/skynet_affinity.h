@@ -0,0 +1,16 @@
+#ifndef skynet_affinity_h
+#define skynet_affinity_h
+
+#include <stddef.h>
+
+int skynet_affinity_cpucount(void);
+// parse cpu list such as "0-3,8", returns the number of cpus, or -1 if the list is invalid
+int skynet_affinity_parse(const char *list, int *cpus, int max);
+// bind current thread to the cpu, returns 0 if succeed
+int skynet_affinity_bind(int cpu);
+// Allocate zeroed pages and touch them in current thread, so they are on the numa node of the cpu it binds (first touch).
+// The small blocks from malloc are in the pages touched by other threads already.
+void * skynet_affinity_alloc(size_t sz);
+void skynet_affinity_free(void *ptr, size_t sz);
+
+#endif
@@ -3,128 +3,419 @@
 #include "skynet_handle.h"
 #include "skynet_imp.h"
 #include "skynet_server.h"
-#include "rwlock.h"
 #include "spinlock.h"
+#include "atomic.h"
 
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
+
+// The readers (skynet_handle_grab, skynet_handle_findname) take no lock and write nothing shared.
+// The writers replace the tables (copy on write) or update the slots in place under the lock, and the old tables, names and contexts
+// are freed after all the reader threads pass a quiescent state (QSBR).
+// A thread not registered (or offline) reads with a shared counter (fallback) instead.
 
 #define HANDLE_CACHE_LINE 64
 
-struct handle_reader_slot {
-	ATOM_INT active;
-	char _pad[HANDLE_CACHE_LINE - sizeof(ATOM_INT)];
+struct handle_reader {
+	ATOM_ULONG epoch;	// the global epoch at the last quiescent state, 0 means offline
+	char _pad[HANDLE_CACHE_LINE - sizeof(ATOM_ULONG)];
 };
 
-static _Thread_local int TLS_SLOT_IDX = -1;
+static _Thread_local struct handle_reader * TLS_READER = NULL;
 
 #define DEFAULT_SLOT_SIZE 4
 #define MAX_SLOT_SIZE 0x40000000
+// the slots moved to the new table by each register/retire while resizing
+#define SLOT_MIGRATE_STEP 32
+
+#define DEFAULT_NAME_SIZE 16
+// the removed name in the name table, the probing goes on
+#define NAME_DELETED ((uintptr_t)1)
 
 struct handle_name {
-	char * name;
+	uint32_t hash;
 	uint32_t handle;
+	struct handle_name * next;	// the other names of the same handle (with lock)
+	char name[];
+};
+
+struct handle_slot {
+	ATOM_POINTER ctx;	// struct skynet_context *
+	uint32_t handle;	// (with lock)
+	struct handle_name * name;	// the names of the handle (with lock)
+};
+
+struct slot_table {
+	int size;
+	struct handle_slot slot[];
+};
+
+// The slots are moved from the old table to the current one step by step while resizing (grow or shrink),
+// the readers look up the current table first, then the old one.
+struct slot_state {
+	struct slot_table * cur;
+	struct slot_table * old;	// NULL if not resizing
+};
+
+// open addressing with linear probing, the readers see the names inserted or removed in place
+struct name_table {
+	int size;	// power of 2
+	int used;	// names and deleted marks (with lock)
+	int count;	// (with lock)
+	ATOM_POINTER name[];	// struct handle_name *
+};
+
+struct retired {
+	void * ptr;
+	unsigned long epoch;
 };
 
 struct handle_storage {
-	struct rwlock lock;
+	struct spinlock lock;	// for writers
 
 	uint32_t harbor;
 	uint32_t handle_index;
-	int slot_size;
-	struct skynet_context ** slot;
-
-	int name_cap;
-	int name_count;
-	struct handle_name *name;
-
-	// distributed reader slots
+	ATOM_POINTER slot;	// struct slot_state *
+	int slot_count;
+	int migrate;	// the next slot of the old table to move
+	int shrink_limit;	// don't shrink again until the count is less than half of it
+	ATOM_SIZET slot_reclaimed;	// bytes freed by shrinking
+	ATOM_POINTER name;	// struct name_table *
+	ATOM_INT name_version;	// increase when any name removed
+
+	ATOM_ULONG epoch;
+	ATOM_INT fallback;
 	ATOM_INT thread_idx;
-	int rslot_count;
-	struct handle_reader_slot *rslots;
+	int reader_count;
+	struct handle_reader *readers;
+
+	ATOM_INT retired_count;
+	int retired_cap;
+	struct retired *retired;
 };
 
 static struct handle_storage *H = NULL;
 
+static inline int
+reader_enter(struct handle_storage *s) {
+	struct handle_reader * r = TLS_READER;
+	if (r && ATOM_LOAD(&r->epoch)) {
+		// online, protected by the quiescent state
+		return 0;
+	}
+	ATOM_FINC(&s->fallback);
+	return 1;
+}
+
 static inline void
-handle_rlock(struct handle_storage *s) {
-	if (TLS_SLOT_IDX >= 0 && TLS_SLOT_IDX < s->rslot_count) {
-		for (;;) {
-			ATOM_STORE(&s->rslots[TLS_SLOT_IDX].active, 1);
-			if (!ATOM_LOAD(&s->lock.write)) {
-				break;
+reader_exit(struct handle_storage *s, int fallback) {
+	if (fallback) {
+		ATOM_FDEC(&s->fallback);
+	}
+}
+
+// Free the retired pointers which no reader can see. (with lock)
+static void
+reclaim(struct handle_storage *s) {
+	int n = ATOM_LOAD(&s->retired_count);
+	if (n == 0)
+		return;
+	// The readers see the new epoch are after the pointers retired.
+	unsigned long min = ATOM_FINC(&s->epoch) + 1;
+	if (ATOM_LOAD(&s->fallback)) {
+		return;
+	}
+	int i;
+	for (i=0;i<s->reader_count;i++) {
+		unsigned long e = ATOM_LOAD(&s->readers[i].epoch);
+		if (e && e < min) {
+			min = e;
+		}
+	}
+	int j = 0;
+	for (i=0;i<n;i++) {
+		if (s->retired[i].epoch < min) {
+			skynet_free(s->retired[i].ptr);
+		} else {
+			s->retired[j++] = s->retired[i];
+		}
+	}
+	ATOM_STORE(&s->retired_count, j);
+}
+
+// (with lock)
+static void
+retire_pointer(struct handle_storage *s, void *ptr) {
+	int n = ATOM_LOAD(&s->retired_count);
+	if (n >= s->retired_cap) {
+		s->retired_cap = s->retired_cap ? s->retired_cap * 2 : 16;
+		s->retired = skynet_realloc(s->retired, s->retired_cap * sizeof(struct retired));
+	}
+	s->retired[n].ptr = ptr;
+	s->retired[n].epoch = ATOM_LOAD(&s->epoch);
+	ATOM_STORE(&s->retired_count, n+1);
+}
+
+static struct slot_table *
+slot_new(int size) {
+	struct slot_table * t = skynet_malloc(sizeof(*t) + size * sizeof(t->slot[0]));
+	t->size = size;
+	int i;
+	for (i=0;i<size;i++) {
+		ATOM_INIT(&t->slot[i].ctx, (uintptr_t)NULL);
+		t->slot[i].handle = 0;
+		t->slot[i].name = NULL;
+	}
+	return t;
+}
+
+static inline size_t
+slot_bytes(int size) {
+	return sizeof(struct slot_table) + size * sizeof(struct handle_slot);
+}
+
+static inline struct handle_slot *
+slot_of(struct slot_table *t, uint32_t handle) {
+	return &t->slot[handle & (t->size-1)];
+}
+
+// (with lock)
+static void
+slot_publish(struct handle_storage *s, struct slot_table *cur, struct slot_table *old) {
+	struct slot_state * st = skynet_malloc(sizeof(*st));
+	st->cur = cur;
+	st->old = old;
+	struct slot_state * ost = (struct slot_state *)ATOM_LOAD(&s->slot);
+	ATOM_STORE(&s->slot, (uintptr_t)st);
+	if (ost) {
+		retire_pointer(s, ost);
+	}
+}
+
+// (with lock)
+static void
+resize_begin(struct handle_storage *s, int size) {
+	struct slot_state * st = (struct slot_state *)ATOM_LOAD(&s->slot);
+	assert(st->old == NULL);
+	s->migrate = 0;
+	slot_publish(s, slot_new(size), st->cur);
+}
+
+// Move n slots of the old table to the current table. (with lock)
+static void
+resize_step(struct handle_storage *s, int n) {
+	struct slot_state * st = (struct slot_state *)ATOM_LOAD(&s->slot);
+	struct slot_table * old = st->old;
+	if (old == NULL)
+		return;
+	struct slot_table * cur = st->cur;
+	while (n-- > 0 && s->migrate < old->size) {
+		struct handle_slot * from = &old->slot[s->migrate];
+		uintptr_t ctx = ATOM_LOAD(&from->ctx);
+		if (ctx) {
+			struct handle_slot * to = slot_of(cur, from->handle);
+			uintptr_t c = ATOM_LOAD(&to->ctx);
+			if (c == (uintptr_t)NULL) {
+				to->handle = from->handle;
+				to->name = from->name;
+				ATOM_STORE(&to->ctx, ctx);
+			} else if (c != ctx) {
+				// Two handles collide in the smaller table, give up shrinking.
+				// The old table is complete, because the slots are registered (or retired) in both tables while shrinking.
+				assert(old->size > cur->size);
+				s->shrink_limit = s->slot_count;
+				slot_publish(s, old, NULL);
+				retire_pointer(s, cur);
+				return;
 			}
-			// Writer present — back off to avoid deadlock
-			ATOM_STORE(&s->rslots[TLS_SLOT_IDX].active, 0);
-			while (ATOM_LOAD(&s->lock.write)) { atomic_pause_(); }
 		}
-	} else {
-		rwlock_rlock(&s->lock);
+		++s->migrate;
+	}
+	if (s->migrate >= old->size) {
+		if (old->size > cur->size) {
+			ATOM_STORE(&s->slot_reclaimed, ATOM_LOAD(&s->slot_reclaimed) + slot_bytes(old->size) - slot_bytes(cur->size));
+			s->shrink_limit = INT_MAX;
+		}
+		slot_publish(s, cur, NULL);
+		retire_pointer(s, old);
 	}
 }
 
-static inline void
-handle_runlock(struct handle_storage *s) {
-	if (TLS_SLOT_IDX >= 0 && TLS_SLOT_IDX < s->rslot_count) {
-		ATOM_STORE(&s->rslots[TLS_SLOT_IDX].active, 0);
+// Go on resizing, or begin to shrink when the table is sparse. (with lock)
+static void
+resize_check(struct handle_storage *s, int n) {
+	resize_step(s, n);
+	struct slot_state * st = (struct slot_state *)ATOM_LOAD(&s->slot);
+	if (st->old == NULL && st->cur->size > DEFAULT_SLOT_SIZE
+		&& s->slot_count * 8 < st->cur->size && s->slot_count * 2 < s->shrink_limit) {
+		resize_begin(s, st->cur->size / 2);
+	}
+}
+
+// The slot of the handle in the current table may be reserved by the old slots not moved yet.
+static int
+slot_reserved(struct slot_table *cur, struct slot_table *old, uint32_t handle) {
+	int mask = cur->size - 1;
+	if (old->size < cur->size) {
+		struct handle_slot * slot = slot_of(old, handle);
+		return ATOM_LOAD(&slot->ctx) && (slot->handle & mask) == (handle & mask);
 	} else {
-		rwlock_runlock(&s->lock);
+		int i;
+		for (i = handle & mask; i < old->size; i += cur->size) {
+			if (ATOM_LOAD(&old->slot[i].ctx))
+				return 1;
+		}
+		return 0;
 	}
 }
 
-static inline void
-handle_wlock(struct handle_storage *s) {
-	rwlock_wlock(&s->lock);
-	// Additionally wait for all slot readers
-	for (int i = 0; i < s->rslot_count; i++) {
-		while (ATOM_LOAD(&s->rslots[i].active)) { atomic_pause_(); }
+// the slots of the handle in the current and the old table (with lock)
+static int
+find_slots(struct handle_storage *s, uint32_t handle, struct handle_slot *slots[2]) {
+	struct slot_state * st = (struct slot_state *)ATOM_LOAD(&s->slot);
+	int n = 0;
+	struct handle_slot * slot = slot_of(st->cur, handle);
+	if (ATOM_LOAD(&slot->ctx) && slot->handle == handle) {
+		slots[n++] = slot;
 	}
+	if (st->old) {
+		slot = slot_of(st->old, handle);
+		if (ATOM_LOAD(&slot->ctx) && slot->handle == handle) {
+			slots[n++] = slot;
+		}
+	}
+	return n;
 }
 
-static inline void
-handle_wunlock(struct handle_storage *s) {
-	rwlock_wunlock(&s->lock);
+static struct name_table *
+name_new(int size) {
+	struct name_table * t = skynet_malloc(sizeof(*t) + size * sizeof(t->name[0]));
+	t->size = size;
+	t->used = 0;
+	t->count = 0;
+	int i;
+	for (i=0;i<size;i++) {
+		ATOM_INIT(&t->name[i], (uintptr_t)NULL);
+	}
+	return t;
+}
+
+uint32_t
+skynet_handle_namehash(const char *name) {
+	size_t l = strlen(name);
+	uint32_t h = (uint32_t)l;
+	size_t i;
+	for (i=0;i<l;i++) {
+		h = h ^ ((h<<5) + (h>>2) + (uint8_t)name[i]);
+	}
+	return h;
 }
 
 uint32_t
 skynet_handle_register(struct skynet_context *ctx) {
 	struct handle_storage *s = H;
 
-	handle_wlock(s);
+	spinlock_lock(&s->lock);
+
+	resize_step(s, SLOT_MIGRATE_STEP);
 
 	for (;;) {
+		struct slot_state * st = (struct slot_state *)ATOM_LOAD(&s->slot);
+		if (st->old == NULL && (s->slot_count + 1) * 4 > st->cur->size * 3) {
+			assert((st->cur->size*2 - 1) <= HANDLE_MASK);
+			resize_begin(s, st->cur->size * 2);
+			st = (struct slot_state *)ATOM_LOAD(&s->slot);
+		}
+		struct slot_table * cur = st->cur;
+		struct slot_table * old = st->old;
 		int i;
 		uint32_t handle = s->handle_index;
-		for (i=0;i<s->slot_size;i++,handle++) {
+		for (i=0;i<cur->size;i++,handle++) {
 			if (handle > HANDLE_MASK) {
 				// 0 is reserved
 				handle = 1;
 			}
-			int hash = handle & (s->slot_size-1);
-			if (s->slot[hash] == NULL) {
-				s->slot[hash] = ctx;
-				s->handle_index = handle + 1;
+			struct handle_slot * slot = slot_of(cur, handle);
+			if (ATOM_LOAD(&slot->ctx) != (uintptr_t)NULL)
+				continue;
+			if (old && slot_reserved(cur, old, handle))
+				continue;
+			s->handle_index = handle + 1;
+			handle |= s->harbor;
+			slot->handle = handle;
+			ATOM_STORE(&slot->ctx, (uintptr_t)ctx);
+			if (old && old->size > cur->size) {
+				// register in both tables while shrinking, so it can give up
+				struct handle_slot * oslot = slot_of(old, handle);
+				oslot->handle = handle;
+				ATOM_STORE(&oslot->ctx, (uintptr_t)ctx);
+			}
+			++s->slot_count;
 
-				handle_wunlock(s);
+			spinlock_unlock(&s->lock);
 
-				handle |= s->harbor;
-				return handle;
-			}
+			return handle;
+		}
+		// no free slot, finish resizing (or grow) first
+		if (old) {
+			resize_step(s, old->size);
+		} else {
+			assert((cur->size*2 - 1) <= HANDLE_MASK);
+			resize_begin(s, cur->size * 2);
 		}
-		assert((s->slot_size*2 - 1) <= HANDLE_MASK);
-		struct skynet_context ** new_slot = skynet_malloc(s->slot_size * 2 * sizeof(struct skynet_context *));
-		memset(new_slot, 0, s->slot_size * 2 * sizeof(struct skynet_context *));
-		for (i=0;i<s->slot_size;i++) {
-			if (s->slot[i]) {
-				int hash = skynet_context_handle(s->slot[i]) & (s->slot_size * 2 - 1);
-				assert(new_slot[hash] == NULL);
-				new_slot[hash] = s->slot[i];
+	}
+}
+
+// Rebuild the name table without the deleted marks, the load factor is no more than 1/2 after it. (with lock)
+static struct name_table *
+name_rebuild(struct handle_storage *s, int count) {
+	struct name_table * t = (struct name_table *)ATOM_LOAD(&s->name);
+	int size = DEFAULT_NAME_SIZE;
+	while (size < count * 2) {
+		size *= 2;
+	}
+	struct name_table * nt = name_new(size);
+	int i;
+	for (i=0;i<t->size;i++) {
+		uintptr_t p = ATOM_LOAD(&t->name[i]);
+		if (p != (uintptr_t)NULL && p != NAME_DELETED) {
+			struct handle_name * n = (struct handle_name *)p;
+			int h = n->hash & (size - 1);
+			while (ATOM_LOAD(&nt->name[h]) != (uintptr_t)NULL) {
+				h = (h + 1) & (size - 1);
 			}
+			ATOM_STORE(&nt->name[h], p);
+			++nt->count;
 		}
-		skynet_free(s->slot);
-		s->slot = new_slot;
-		s->slot_size *= 2;
+	}
+	nt->used = nt->count;
+	ATOM_STORE(&s->name, (uintptr_t)nt);
+	retire_pointer(s, t);
+	return nt;
+}
+
+// remove the names of the handle (with lock)
+static void
+remove_names(struct handle_storage *s, struct handle_name *n) {
+	if (n == NULL)
+		return;
+	struct name_table * t = (struct name_table *)ATOM_LOAD(&s->name);
+	while (n) {
+		struct handle_name * next = n->next;
+		int h = n->hash & (t->size - 1);
+		while (ATOM_LOAD(&t->name[h]) != (uintptr_t)n) {
+			h = (h + 1) & (t->size - 1);
+		}
+		ATOM_STORE(&t->name[h], NAME_DELETED);
+		--t->count;
+		retire_pointer(s, n);
+		n = next;
+	}
+	ATOM_FINC(&s->name_version);
+	if (t->size > DEFAULT_NAME_SIZE && t->count * 8 < t->size) {
+		name_rebuild(s, t->count);
 	}
 }
 
@@ -132,35 +423,33 @@ int
 skynet_handle_retire(uint32_t handle) {
 	int ret = 0;
 	struct handle_storage *s = H;
+	struct skynet_context * ctx = NULL;
 
-	handle_wlock(s);
-
-	uint32_t hash = handle & (s->slot_size-1);
-	struct skynet_context * ctx = s->slot[hash];
+	spinlock_lock(&s->lock);
 
-	if (ctx != NULL && skynet_context_handle(ctx) == handle) {
-		s->slot[hash] = NULL;
-		ret = 1;
+	struct handle_slot * slots[2];
+	int n = find_slots(s, handle, slots);
+	if (n > 0) {
+		ctx = (struct skynet_context *)ATOM_LOAD(&slots[0]->ctx);
+		struct handle_name * names = slots[0]->name;
 		int i;
-		int j=0, n=s->name_count;
-		for (i=0; i<n; ++i) {
-			if (s->name[i].handle == handle) {
-				skynet_free(s->name[i].name);
-				continue;
-			} else if (i!=j) {
-				s->name[j] = s->name[i];
-			}
-			++j;
+		for (i=0;i<n;i++) {
+			ATOM_STORE(&slots[i]->ctx, (uintptr_t)NULL);
+			slots[i]->handle = 0;
+			slots[i]->name = NULL;
 		}
-		s->name_count = j;
-	} else {
-		ctx = NULL;
+		--s->slot_count;
+		ret = 1;
+		remove_names(s, names);
+
+		resize_check(s, SLOT_MIGRATE_STEP);
+		reclaim(s);
 	}
 
-	handle_wunlock(s);
+	spinlock_unlock(&s->lock);
 
 	if (ctx) {
-		// release ctx may call skynet_handle_* , so wunlock first.
+		// release ctx may call skynet_handle_* , so unlock first.
 		skynet_context_release(ctx);
 	}
 
@@ -173,15 +462,22 @@ skynet_handle_retireall() {
 	for (;;) {
 		int n=0;
 		int i;
-		for (i=0;i<s->slot_size;i++) {
-			handle_rlock(s);
-			struct skynet_context * ctx = s->slot[i];
+		for (i=0;;i++) {
+			int fallback = reader_enter(s);
+			struct slot_state * st = (struct slot_state *)ATOM_LOAD(&s->slot);
+			int total = st->cur->size + (st->old ? st->old->size : 0);
+			if (i >= total) {
+				reader_exit(s, fallback);
+				break;
+			}
+			struct handle_slot * slot = i < st->cur->size ? &st->cur->slot[i] : &st->old->slot[i - st->cur->size];
+			struct skynet_context * ctx = (struct skynet_context *)ATOM_LOAD(&slot->ctx);
 			uint32_t handle = 0;
 			if (ctx) {
 				handle = skynet_context_handle(ctx);
 				++n;
 			}
-			handle_runlock(s);
+			reader_exit(s, fallback);
 			if (handle != 0) {
 				skynet_handle_retire(handle);
 			}
@@ -191,121 +487,211 @@ skynet_handle_retireall() {
 	}
 }
 
+static inline struct skynet_context *
+slot_context(struct slot_table *t, uint32_t handle) {
+	struct skynet_context * ctx = (struct skynet_context *)ATOM_LOAD(&slot_of(t, handle)->ctx);
+	if (ctx && skynet_context_handle(ctx) == handle) {
+		return ctx;
+	}
+	return NULL;
+}
+
 struct skynet_context *
 skynet_handle_grab(uint32_t handle) {
 	struct handle_storage *s = H;
 	struct skynet_context * result = NULL;
 
-	handle_rlock(s);
+	int fallback = reader_enter(s);
 
-	uint32_t hash = handle & (s->slot_size-1);
-	struct skynet_context * ctx = s->slot[hash];
-	if (ctx && skynet_context_handle(ctx) == handle) {
+	struct slot_state * st = (struct slot_state *)ATOM_LOAD(&s->slot);
+	// The context may be retired and released, but the memory is still valid here.
+	struct skynet_context * ctx = slot_context(st->cur, handle);
+	if (ctx == NULL && st->old) {
+		ctx = slot_context(st->old, handle);
+	}
+	if (ctx && skynet_context_trygrab(ctx)) {
 		result = ctx;
-		skynet_context_grab(result);
 	}
 
-	handle_runlock(s);
+	reader_exit(s, fallback);
 
 	return result;
 }
 
+int
+skynet_handle_slotsize(void) {
+	struct handle_storage *s = H;
+	int fallback = reader_enter(s);
+	struct slot_state * st = (struct slot_state *)ATOM_LOAD(&s->slot);
+	int size = st->cur->size;
+	reader_exit(s, fallback);
+	return size;
+}
+
+size_t
+skynet_handle_slotreclaimed(void) {
+	return ATOM_LOAD(&H->slot_reclaimed);
+}
+
 uint32_t
-skynet_handle_findname(const char * name) {
+skynet_handle_nameversion(void) {
+	return (uint32_t)ATOM_LOAD(&H->name_version);
+}
+
+uint32_t
+skynet_handle_findname_hash(const char * name, uint32_t hash) {
 	struct handle_storage *s = H;
 
-	handle_rlock(s);
+	int fallback = reader_enter(s);
 
+	struct name_table * t = (struct name_table *)ATOM_LOAD(&s->name);
 	uint32_t handle = 0;
-
-	int begin = 0;
-	int end = s->name_count - 1;
-	while (begin<=end) {
-		int mid = (begin+end)/2;
-		struct handle_name *n = &s->name[mid];
-		int c = strcmp(n->name, name);
-		if (c==0) {
-			handle = n->handle;
+	int mask = t->size - 1;
+	int h = hash & mask;
+	for (;;) {
+		uintptr_t p = ATOM_LOAD(&t->name[h]);
+		if (p == (uintptr_t)NULL)
 			break;
+		if (p != NAME_DELETED) {
+			struct handle_name * n = (struct handle_name *)p;
+			if (n->hash == hash && strcmp(n->name, name) == 0) {
+				handle = n->handle;
+				break;
+			}
 		}
-		if (c<0) {
-			begin = mid + 1;
-		} else {
-			end = mid - 1;
-		}
+		h = (h + 1) & mask;
 	}
 
-	handle_runlock(s);
+	reader_exit(s, fallback);
 
 	return handle;
 }
 
-static void
-_insert_name_before(struct handle_storage *s, char *name, uint32_t handle, int before) {
-	if (s->name_count >= s->name_cap) {
-		s->name_cap *= 2;
-		assert(s->name_cap <= MAX_SLOT_SIZE);
-		struct handle_name * n = skynet_malloc(s->name_cap * sizeof(struct handle_name));
-		int i;
-		for (i=0;i<before;i++) {
-			n[i] = s->name[i];
-		}
-		for (i=before;i<s->name_count;i++) {
-			n[i+1] = s->name[i];
-		}
-		skynet_free(s->name);
-		s->name = n;
-	} else {
-		int i;
-		for (i=s->name_count;i>before;i--) {
-			s->name[i] = s->name[i-1];
-		}
-	}
-	s->name[before].name = name;
-	s->name[before].handle = handle;
-	s->name_count ++;
+uint32_t
+skynet_handle_findname(const char * name) {
+	return skynet_handle_findname_hash(name, skynet_handle_namehash(name));
 }
 
 static const char *
 _insert_name(struct handle_storage *s, const char * name, uint32_t handle) {
-	int begin = 0;
-	int end = s->name_count - 1;
-	while (begin<=end) {
-		int mid = (begin+end)/2;
-		struct handle_name *n = &s->name[mid];
-		int c = strcmp(n->name, name);
-		if (c==0) {
-			return NULL;
-		}
-		if (c<0) {
-			begin = mid + 1;
+	struct name_table * t = (struct name_table *)ATOM_LOAD(&s->name);
+	uint32_t hash = skynet_handle_namehash(name);
+	int mask = t->size - 1;
+	int h = hash & mask;
+	int free_slot = -1;
+	for (;;) {
+		uintptr_t p = ATOM_LOAD(&t->name[h]);
+		if (p == (uintptr_t)NULL)
+			break;
+		if (p == NAME_DELETED) {
+			if (free_slot < 0)
+				free_slot = h;
 		} else {
-			end = mid - 1;
+			struct handle_name * n = (struct handle_name *)p;
+			if (n->hash == hash && strcmp(n->name, name) == 0) {
+				return NULL;
+			}
 		}
+		h = (h + 1) & mask;
+	}
+	size_t sz = strlen(name) + 1;
+	struct handle_name * n = skynet_malloc(sizeof(*n) + sz);
+	n->hash = hash;
+	n->handle = handle;
+	n->next = NULL;
+	memcpy(n->name, name, sz);
+
+	if (free_slot < 0) {
+		if ((t->used + 1) * 4 > t->size * 3) {
+			t = name_rebuild(s, t->count + 1);
+			mask = t->size - 1;
+			h = hash & mask;
+			while (ATOM_LOAD(&t->name[h]) != (uintptr_t)NULL) {
+				h = (h + 1) & mask;
+			}
+		}
+		free_slot = h;
+		++t->used;
+	}
+	++t->count;
+	ATOM_STORE(&t->name[free_slot], (uintptr_t)n);
+
+	// link to the handle, so the names can be removed when it retires
+	struct handle_slot * slots[2];
+	int i, ns = find_slots(s, handle, slots);
+	if (ns > 0) {
+		n->next = slots[0]->name;
+	}
+	for (i=0;i<ns;i++) {
+		slots[i]->name = n;
 	}
-	char * result = skynet_strdup(name);
-
-	_insert_name_before(s, result, handle, begin);
 
-	return result;
+	return n->name;
 }
 
 const char *
 skynet_handle_namehandle(uint32_t handle, const char *name) {
-	handle_wlock(H);
+	spinlock_lock(&H->lock);
 
 	const char * ret = _insert_name(H, name, handle);
+	reclaim(H);
 
-	handle_wunlock(H);
+	spinlock_unlock(&H->lock);
 
 	return ret;
 }
 
+void
+skynet_handle_free(void *p) {
+	struct handle_storage *s = H;
+	spinlock_lock(&s->lock);
+	retire_pointer(s, p);
+	reclaim(s);
+	spinlock_unlock(&s->lock);
+}
+
+void
+skynet_handle_reclaim(void) {
+	struct handle_storage *s = H;
+	spinlock_lock(&s->lock);
+	// the timer thread finishes resizing when there is no register/retire
+	resize_check(s, SLOT_MIGRATE_STEP * 64);
+	reclaim(s);
+	spinlock_unlock(&s->lock);
+}
+
+void
+skynet_handle_quiescent(void) {
+	struct handle_reader * r = TLS_READER;
+	if (r) {
+		ATOM_STORE(&r->epoch, ATOM_LOAD(&H->epoch));
+	}
+}
+
+void
+skynet_handle_offline(void) {
+	struct handle_reader * r = TLS_READER;
+	if (r) {
+		ATOM_STORE(&r->epoch, 0);
+	}
+}
+
+void
+skynet_handle_online(void) {
+	struct handle_reader * r = TLS_READER;
+	if (r) {
+		ATOM_STORE(&r->epoch, ATOM_LOAD(&H->epoch));
+		// the reclaimer must see it before we read the tables
+		ATOM_FENCE();
+	}
+}
+
 void
 skynet_handle_register_thread(void) {
 	int idx = ATOM_FINC(&H->thread_idx);
-	if (idx < H->rslot_count) {
-		TLS_SLOT_IDX = idx;
+	if (idx < H->reader_count) {
+		TLS_READER = &H->readers[idx];
+		skynet_handle_online();
 	}
 }
 
@@ -313,25 +699,34 @@ void
 skynet_handle_init(int harbor, int thread) {
 	assert(H==NULL);
 	struct handle_storage * s = skynet_malloc(sizeof(*H));
-	s->slot_size = DEFAULT_SLOT_SIZE;
-	s->slot = skynet_malloc(s->slot_size * sizeof(struct skynet_context *));
-	memset(s->slot, 0, s->slot_size * sizeof(struct skynet_context *));
-
-	rwlock_init(&s->lock);
-
-	// Distributed reader slots: workers + monitor + timer + socket
-	s->rslot_count = thread + 3;
-	size_t rslot_sz = (size_t)s->rslot_count * sizeof(struct handle_reader_slot);
-	s->rslots = (struct handle_reader_slot *)skynet_malloc(rslot_sz);
-	memset(s->rslots, 0, rslot_sz);
+	struct slot_state * st = skynet_malloc(sizeof(*st));
+	st->cur = slot_new(DEFAULT_SLOT_SIZE);
+	st->old = NULL;
+	ATOM_INIT(&s->slot, (uintptr_t)st);
+	s->slot_count = 0;
+	s->migrate = 0;
+	s->shrink_limit = INT_MAX;
+	ATOM_INIT(&s->slot_reclaimed, 0);
+	ATOM_INIT(&s->name, (uintptr_t)name_new(DEFAULT_NAME_SIZE));
+	ATOM_INIT(&s->name_version, 0);
+
+	spinlock_init(&s->lock);
+
+	// reader threads: workers and sockets (thread) + monitor + timer
+	s->reader_count = thread + 2;
+	size_t sz = (size_t)s->reader_count * sizeof(struct handle_reader);
+	s->readers = (struct handle_reader *)skynet_malloc(sz);
+	memset(s->readers, 0, sz);
 	ATOM_INIT(&s->thread_idx, 0);
+	ATOM_INIT(&s->epoch, 1);
+	ATOM_INIT(&s->fallback, 0);
+	ATOM_INIT(&s->retired_count, 0);
+	s->retired_cap = 0;
+	s->retired = NULL;
 
 	// reserve 0 for system
 	s->harbor = (uint32_t) (harbor & 0xff) << HANDLE_REMOTE_SHIFT;
 	s->handle_index = 1;
-	s->name_cap = 2;
-	s->name_count = 0;
-	s->name = skynet_malloc(s->name_cap * sizeof(struct handle_name));
 
 	H = s;
 
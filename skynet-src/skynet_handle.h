@@ -2,6 +2,7 @@
 #define SKYNET_CONTEXT_HANDLE_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 // reserve high 8 bits for remote id
 #define HANDLE_MASK 0xffffff
@@ -13,11 +14,28 @@ uint32_t skynet_handle_register(struct skynet_context *);
 int skynet_handle_retire(uint32_t handle);
 struct skynet_context * skynet_handle_grab(uint32_t handle);
 void skynet_handle_retireall();
+int skynet_handle_slotsize(void);
+size_t skynet_handle_slotreclaimed(void);
 
 uint32_t skynet_handle_findname(const char * name);
+uint32_t skynet_handle_namehash(const char * name);
+uint32_t skynet_handle_findname_hash(const char * name, uint32_t hash);
+// increase when any name removed, a name resolved is valid if the version is not changed
+uint32_t skynet_handle_nameversion(void);
 const char * skynet_handle_namehandle(uint32_t handle, const char *name);
 
 void skynet_handle_init(int harbor, int thread);
+
+// The registered threads read the handle storage without lock, they should report the quiescent state
+// (don't hold anything read from the storage) periodically, and be offline before blocking.
 void skynet_handle_register_thread();
+void skynet_handle_quiescent(void);
+void skynet_handle_offline(void);
+void skynet_handle_online(void);
+
+// free p when no reader can see it
+void skynet_handle_free(void *p);
+// free the retired memory and go on resizing the slot table, called periodically
+void skynet_handle_reclaim(void);
 
 #endif
@@ -0,0 +1,58 @@
+#include "skynet_histogram.h"
+
+#include <string.h>
+
+void
+skynet_histogram_init(struct skynet_histogram *h) {
+	memset(h, 0, sizeof(*h));
+}
+
+static inline int
+bucket_index(uint32_t v) {
+	if (v < HISTOGRAM_SUB)
+		return v;
+	int e = 31 - __builtin_clz(v);	// e >= HISTOGRAM_SUB_BITS
+	int shift = e - HISTOGRAM_SUB_BITS;
+	return (shift + 1) * HISTOGRAM_SUB + ((v >> shift) & (HISTOGRAM_SUB - 1));
+}
+
+// the highest value in the bucket
+static inline uint64_t
+bucket_value(int index) {
+	int group = index / HISTOGRAM_SUB;
+	uint64_t sub = index % HISTOGRAM_SUB;
+	if (group == 0)
+		return sub;
+	int shift = group - 1;
+	return ((HISTOGRAM_SUB + sub + 1) << shift) - 1;
+}
+
+void
+skynet_histogram_record(struct skynet_histogram *h, uint64_t v) {
+	++h->count;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+	if (v > UINT32_MAX)
+		v = UINT32_MAX;
+	++h->bucket[bucket_index((uint32_t)v)];
+}
+
+uint64_t
+skynet_histogram_percentile(struct skynet_histogram *h, double p) {
+	if (h->count == 0)
+		return 0;
+	uint64_t rank = (uint64_t)(h->count * p / 100.0 + 0.5);
+	if (rank < 1)
+		rank = 1;
+	uint64_t n = 0;
+	int i;
+	for (i=0;i<HISTOGRAM_BUCKETS;i++) {
+		n += h->bucket[i];
+		if (n >= rank) {
+			uint64_t v = bucket_value(i);
+			return v < h->max ? v : h->max;
+		}
+	}
+	return h->max;
+}
@@ -0,0 +1,24 @@
+#ifndef skynet_histogram_h
+#define skynet_histogram_h
+
+#include <stdint.h>
+
+// log-linear (HDR style) histogram : each power of 2 is split into 8 buckets, the error is less than 12.5%
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB (1 << HISTOGRAM_SUB_BITS)
+// values are clamped to 32bits
+#define HISTOGRAM_BUCKETS ((32 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB)
+
+struct skynet_histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint32_t bucket[HISTOGRAM_BUCKETS];
+};
+
+void skynet_histogram_init(struct skynet_histogram *h);
+void skynet_histogram_record(struct skynet_histogram *h, uint64_t v);
+// p in [0,100], returns the highest value of the bucket which the percentile is in
+uint64_t skynet_histogram_percentile(struct skynet_histogram *h, double p);
+
+#endif
@@ -7,6 +7,15 @@ struct skynet_config {
 	int thread;
 	int harbor;
 	int profile;
+	int dispatch_budget;
+	int worksteal;
+	int socket_cpu;
+	int socket_thread;	// the number of socket poller threads
+	int timer_cpu;
+	int timer_resolution;	// ms per tick
+	int timer_idle;
+	int numa;
+	const char * worker_cpu;
 	const char * daemon;
 	const char * module_path;
 	const char * bootstrap;
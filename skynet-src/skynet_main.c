@@ -17,6 +17,9 @@
 #define SKYNET_MAXTHREAD 1024
 #endif
 
+// the limit of socket_server (MAX_POLLER)
+#define SKYNET_MAXSOCKETTHREAD 64
+
 static int
 optint(const char *key, int opt) {
 	const char * str = skynet_getenv(key);
@@ -162,6 +165,17 @@ main(int argc, char *argv[]) {
 		fprintf(stderr, "Invalid thread %d , should be in [1,%d]\n", config.thread, SKYNET_MAXTHREAD);
 		return 1;
 	}
+	config.worker_cpu = optstring("worker_cpu", NULL);
+	config.socket_cpu = optint("socket_cpu", -1);
+	config.socket_thread = optint("socket_thread", 1);
+	if (config.socket_thread < 1 || config.socket_thread > SKYNET_MAXSOCKETTHREAD) {
+		fprintf(stderr, "Invalid socket_thread %d , should be in [1,%d]\n", config.socket_thread, SKYNET_MAXSOCKETTHREAD);
+		return 1;
+	}
+	config.timer_cpu = optint("timer_cpu", -1);
+	config.timer_resolution = optint("timer_resolution", 10);
+	config.timer_idle = optboolean("timer_idle", 0);
+	config.numa = optboolean("numa", 0);
 	config.module_path = optstring("cpath","./cservice/?.so");
 	config.harbor = optint("harbor", 1);
 	config.bootstrap = optstring("bootstrap","snlua bootstrap");
@@ -169,6 +183,8 @@ main(int argc, char *argv[]) {
 	config.logger = optstring("logger", NULL);
 	config.logservice = optstring("logservice", "logger");
 	config.profile = optboolean("profile", 1);
+	config.dispatch_budget = optint("dispatch_budget", 0);
+	config.worksteal = optboolean("worksteal", 0);
 
 	skynet_start(&config);
 	skynet_globalexit();
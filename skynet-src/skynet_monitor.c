@@ -2,6 +2,7 @@
 
 #include "skynet_monitor.h"
 #include "skynet_server.h"
+#include "skynet_affinity.h"
 #include "skynet.h"
 #include "atomic.h"
 
@@ -13,6 +14,7 @@ struct skynet_monitor {
 	int check_version;
 	uint32_t source;
 	uint32_t destination;
+	int local;	// allocated by skynet_monitor_new_local
 };
 
 struct skynet_monitor * 
@@ -22,9 +24,23 @@ skynet_monitor_new() {
 	return ret;
 }
 
+// for the numa mode, call it in the worker thread after binding the cpu
+struct skynet_monitor *
+skynet_monitor_new_local() {
+	struct skynet_monitor * ret = skynet_affinity_alloc(sizeof(*ret));
+	if (ret == NULL)
+		return skynet_monitor_new();
+	ret->local = 1;
+	return ret;
+}
+
 void 
 skynet_monitor_delete(struct skynet_monitor *sm) {
-	skynet_free(sm);
+	if (sm->local) {
+		skynet_affinity_free(sm, sizeof(*sm));
+	} else {
+		skynet_free(sm);
+	}
 }
 
 void 
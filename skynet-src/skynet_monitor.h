@@ -6,6 +6,7 @@
 struct skynet_monitor;
 
 struct skynet_monitor * skynet_monitor_new();
+struct skynet_monitor * skynet_monitor_new_local();	// on the numa node of current thread
 void skynet_monitor_delete(struct skynet_monitor *);
 void skynet_monitor_trigger(struct skynet_monitor *, uint32_t source, uint32_t destination);
 void skynet_monitor_check(struct skynet_monitor *);
@@ -1,13 +1,17 @@
 #include "skynet.h"
 #include "skynet_mq.h"
 #include "skynet_handle.h"
+#include "skynet_timer.h"
+#include "skynet_affinity.h"
 #include "spinlock.h"
+#include "atomic.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #define DEFAULT_QUEUE_SIZE 64
 #define MAX_GLOBAL_MQ 0x10000
@@ -17,6 +21,15 @@
 
 #define MQ_IN_GLOBAL 1
 #define MQ_OVERLOAD 1024
+#define MQ_CACHE_LINE 64
+
+#ifdef USE_LATENCY_STAT
+#define STAMP_MESSAGE(m) (m)->stamp = skynet_clock_time();
+#else
+#define STAMP_MESSAGE(m)
+#endif
+
+#ifndef USE_LOCKFREE_MQ
 
 struct message_queue {
 	struct spinlock lock;
@@ -28,52 +41,420 @@ struct message_queue {
 	int in_global;
 	int overload;
 	int overload_threshold;
+	int priority;
 	struct skynet_message *queue;
 	struct message_queue *next;
 };
 
+#else
+
+// Lock-free multi-producer / single-consumer queue.
+// Messages are stored in a linked list of fixed size blocks. A producer reserves a slot
+// by increasing block->reserve, and then publishes it with the ready flag.
+// The consumer (the worker which owns the queue by in_global) reads the slots in order.
+// in_global counts the signals (pushes) since the queue is owned, and 0 means nobody owns it.
+// The producer which signals first takes the queue, and the owner gives it up only if no signal comes
+// after it finds the queue empty, see skynet_mq_pop_batch.
+
+// keep the signal count small when the queue is owned for long
+#define MQ_SIGNAL_LIMIT 0x10000000
+
+#define MQ_BLOCK_SIZE DEFAULT_QUEUE_SIZE
+
+struct mq_slot {
+	ATOM_INT ready;
+	struct skynet_message message;
+};
+
+struct mq_block {
+	ATOM_POINTER next;
+	ATOM_INT reserve;
+	struct mq_block *retired;
+	struct mq_slot slot[MQ_BLOCK_SIZE];
+};
+
+struct message_queue {
+	// producer side
+	ATOM_POINTER tail;
+	ATOM_INT writers;
+	ATOM_INT pushed;
+	ATOM_INT in_global;
+	char _pad[MQ_CACHE_LINE - sizeof(ATOM_POINTER) - sizeof(ATOM_INT) * 3];
+	// consumer side
+	struct mq_block *head;
+	int head_pos;
+	ATOM_INT popped;
+	struct mq_block *retired;
+	uint32_t handle;
+	ATOM_INT release;
+	int overload;
+	int overload_threshold;
+	int priority;
+	struct message_queue *next;
+};
+
+#endif
+
+// Run queues keep a list for each priority level. Pop takes the highest level first,
+// but gives the lower levels a turn at intervals to avoid starvation.
+
+#define PRIORITY_NORMAL_TURN 8
+#define PRIORITY_LOW_TURN 64
+
 struct global_queue {
-	struct message_queue *head;
-	struct message_queue *tail;
+	struct message_queue *head[MQ_PRIORITY_LEVEL];
+	struct message_queue *tail[MQ_PRIORITY_LEVEL];
+	int count;
+	unsigned turn;
+	struct spinlock lock;
+};
+
+// Each worker owns a local run queue when work stealing is enabled (see skynet_mq_init).
+// Queues pushed by a worker go to its local run queue, others go to the global queue (Q).
+// A worker pops its local queue first, then the global queue, and steals from its peers at last.
+
+#define GLOBAL_CHECK_INTERVAL 61
+
+struct worker_queue {
+	struct global_queue q;
+	unsigned tick;
+	// parking slot
+	int wakeup;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	char _pad[MQ_CACHE_LINE];
+};
+
+// Idle workers park on their own slot. Pushing a queue into run queues wakes exactly one of them,
+// unless there is a worker just woken up and searching for queues (spinning) already.
+// The spinning worker wakes up the next one when it finds a queue and more work is left.
+struct idle_worker {
 	struct spinlock lock;
+	ATOM_INT sleep;
+	ATOM_INT spinning;
+	int quit;
+	int *id;
 };
 
 static struct global_queue *Q = NULL;
+static struct worker_queue **WQ = NULL;
+static int WQ_COUNT = 0;
+static int WORKSTEAL = 0;
+static struct idle_worker *I = NULL;
 
-void 
-skynet_globalmq_push(struct message_queue * queue) {
-	struct global_queue *q= Q;
+static _Thread_local int TLS_WORKER = -1;
+static _Thread_local int TLS_SPINNING = 0;
 
+static void
+queue_push(struct global_queue *q, struct message_queue * queue) {
+	int level = queue->priority;
 	SPIN_LOCK(q)
 	assert(queue->next == NULL);
-	if(q->tail) {
-		q->tail->next = queue;
-		q->tail = queue;
+	if(q->tail[level]) {
+		q->tail[level]->next = queue;
+		q->tail[level] = queue;
 	} else {
-		q->head = q->tail = queue;
+		q->head[level] = q->tail[level] = queue;
 	}
+	++q->count;
 	SPIN_UNLOCK(q)
 }
 
-struct message_queue * 
-skynet_globalmq_pop() {
-	struct global_queue *q = Q;
+static int
+pop_level(struct global_queue *q) {
+	unsigned turn = ++q->turn;
+	if (turn % PRIORITY_LOW_TURN == 0 && q->head[MQ_PRIORITY_LOW])
+		return MQ_PRIORITY_LOW;
+	if (turn % PRIORITY_NORMAL_TURN == 0 && q->head[MQ_PRIORITY_NORMAL])
+		return MQ_PRIORITY_NORMAL;
+	int i;
+	for (i=0;i<MQ_PRIORITY_LEVEL;i++) {
+		if (q->head[i])
+			return i;
+	}
+	return -1;
+}
 
+static struct message_queue *
+queue_pop(struct global_queue *q) {
+	struct message_queue *mq = NULL;
 	SPIN_LOCK(q)
-	struct message_queue *mq = q->head;
-	if(mq) {
-		q->head = mq->next;
-		if(q->head == NULL) {
-			assert(mq == q->tail);
-			q->tail = NULL;
+	int level = pop_level(q);
+	if (level >= 0) {
+		mq = q->head[level];
+		q->head[level] = mq->next;
+		if(q->head[level] == NULL) {
+			assert(mq == q->tail[level]);
+			q->tail[level] = NULL;
 		}
 		mq->next = NULL;
+		--q->count;
 	}
 	SPIN_UNLOCK(q)
 
 	return mq;
 }
 
+static struct message_queue *
+steal(int id) {
+	int i;
+	for (i=1;i<WQ_COUNT;i++) {
+		struct global_queue *victim = &WQ[(id + i) % WQ_COUNT]->q;
+		// read count without lock, it's only a hint
+		if (victim->count == 0)
+			continue;
+		struct message_queue *mq = queue_pop(victim);
+		if (mq)
+			return mq;
+	}
+	return NULL;
+}
+
+static void
+wakeup_worker() {
+	// pair with the ATOM_FINC in skynet_globalmq_wait (and ATOM_FDEC of spinning in stop_spinning),
+	// either the pusher sees the sleeper, or the sleeper sees the queue pushed.
+	ATOM_FENCE();
+	if (ATOM_LOAD(&I->sleep) == 0 || ATOM_LOAD(&I->spinning) != 0)
+		return;
+	if (!ATOM_CAS(&I->spinning, 0, 1))
+		return;
+	int id = -1;
+	SPIN_LOCK(I)
+	int n = ATOM_LOAD(&I->sleep);
+	if (n > 0) {
+		id = I->id[--n];
+		ATOM_STORE(&I->sleep, n);
+	}
+	SPIN_UNLOCK(I)
+	if (id >= 0) {
+		struct worker_queue *w = WQ[id];
+		pthread_mutex_lock(&w->mutex);
+		w->wakeup = 1;
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->mutex);
+	} else {
+		ATOM_FDEC(&I->spinning);
+	}
+}
+
+static int has_work(int id);
+
+static void
+stop_spinning(int id, struct message_queue *mq) {
+	TLS_SPINNING = 0;
+	ATOM_FDEC(&I->spinning);
+	if (mq && has_work(id)) {
+		// this worker is busy now, wake up another one for the rest.
+		wakeup_worker();
+	}
+}
+
+void 
+skynet_globalmq_push(struct message_queue * queue) {
+	int id = TLS_WORKER;
+	if (id < 0 || !WORKSTEAL) {
+		queue_push(Q, queue);
+	} else {
+		queue_push(&WQ[id]->q, queue);
+	}
+	wakeup_worker();
+}
+
+static struct message_queue *
+worker_pop(int id) {
+	struct worker_queue *w = WQ[id];
+	struct message_queue *mq;
+	// check the global queue first at intervals, or it may starve when the local queue is always busy.
+	if (++w->tick % GLOBAL_CHECK_INTERVAL == 0 && (mq = queue_pop(Q))) {
+		return mq;
+	}
+	if ((mq = queue_pop(&w->q)))
+		return mq;
+	if ((mq = queue_pop(Q)))
+		return mq;
+	return steal(id);
+}
+
+struct message_queue * 
+skynet_globalmq_pop() {
+	int id = TLS_WORKER;
+	struct message_queue *mq;
+	if (id < 0 || !WORKSTEAL) {
+		mq = queue_pop(Q);
+	} else {
+		mq = worker_pop(id);
+	}
+	if (TLS_SPINNING) {
+		stop_spinning(id, mq);
+	}
+	return mq;
+}
+
+static int
+has_work(int id) {
+	// read count without lock, it's only a hint
+	if (Q->count)
+		return 1;
+	if (WORKSTEAL) {
+		int i;
+		for (i=0;i<WQ_COUNT;i++) {
+			if (WQ[(id + i) % WQ_COUNT]->q.count)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+cancel_wait(int id) {
+	int ret = 0;
+	SPIN_LOCK(I)
+	int i;
+	int n = ATOM_LOAD(&I->sleep);
+	for (i=0;i<n;i++) {
+		if (I->id[i] == id) {
+			I->id[i] = I->id[--n];
+			ATOM_STORE(&I->sleep, n);
+			ret = 1;
+			break;
+		}
+	}
+	SPIN_UNLOCK(I)
+	return ret;
+}
+
+void
+skynet_globalmq_wait() {
+	int id = TLS_WORKER;
+	assert(id >= 0);
+	struct worker_queue *w = WQ[id];
+	SPIN_LOCK(I)
+	int n = ATOM_LOAD(&I->sleep);
+	I->id[n] = id;
+	ATOM_FINC(&I->sleep);
+	SPIN_UNLOCK(I)
+
+	// A queue may be pushed before the worker is in the idle list, check again.
+	// If it's not in the idle list, someone is waking it up, so wait for the wakeup below.
+	if (has_work(id) && cancel_wait(id)) {
+		return;
+	}
+
+	pthread_mutex_lock(&w->mutex);
+	while (!w->wakeup && !I->quit) {
+		pthread_cond_wait(&w->cond, &w->mutex);
+	}
+	if (w->wakeup) {
+		// the waker increased spinning for this worker
+		w->wakeup = 0;
+		TLS_SPINNING = 1;
+	}
+	pthread_mutex_unlock(&w->mutex);
+}
+
+void
+skynet_globalmq_exit() {
+	int i;
+	SPIN_LOCK(I)
+	I->quit = 1;
+	SPIN_UNLOCK(I)
+	for (i=0;i<WQ_COUNT;i++) {
+		struct worker_queue *w = WQ[i];
+		if (w == NULL) {
+			// numa mode, the worker isn't started
+			continue;
+		}
+		pthread_mutex_lock(&w->mutex);
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->mutex);
+	}
+}
+
+static struct worker_queue *
+worker_queue_new(int local) {
+	struct worker_queue *w = local ? skynet_affinity_alloc(sizeof(*w)) : NULL;
+	if (w == NULL) {
+		w = skynet_malloc(sizeof(*w));
+		memset(w, 0, sizeof(*w));
+	}
+	SPIN_INIT(&w->q);
+	if (pthread_mutex_init(&w->mutex, NULL)) {
+		fprintf(stderr, "Init mutex error");
+		exit(1);
+	}
+	if (pthread_cond_init(&w->cond, NULL)) {
+		fprintf(stderr, "Init cond error");
+		exit(1);
+	}
+	return w;
+}
+
+void
+skynet_mq_register_worker(int id) {
+	if (id < WQ_COUNT) {
+		if (WQ[id] == NULL) {
+			// numa mode : the pages are allocated and touched first by the worker thread (bound already), on its local node
+			WQ[id] = worker_queue_new(1);
+		}
+		TLS_WORKER = id;
+	}
+}
+
+uint32_t 
+skynet_mq_handle(struct message_queue *q) {
+	return q->handle;
+}
+
+void
+skynet_mq_setpriority(struct message_queue *q, int priority) {
+	assert(priority >= 0 && priority < MQ_PRIORITY_LEVEL);
+	// It takes effect when the queue is pushed into run queues next time.
+	q->priority = priority;
+}
+
+int
+skynet_mq_priority(struct message_queue *q) {
+	return q->priority;
+}
+
+int
+skynet_mq_overload(struct message_queue *q) {
+	if (q->overload) {
+		int overload = q->overload;
+		q->overload = 0;
+		return overload;
+	} 
+	return 0;
+}
+
+void 
+skynet_mq_init(int worker, int worksteal, int numa) {
+	struct global_queue *q = skynet_malloc(sizeof(*q));
+	memset(q,0,sizeof(*q));
+	SPIN_INIT(q);
+	Q=q;
+
+	int i;
+	WQ = skynet_malloc(worker * sizeof(struct worker_queue *));
+	for (i=0;i<worker;i++) {
+		// in numa mode, each worker allocates its own in skynet_mq_register_worker
+		WQ[i] = numa ? NULL : worker_queue_new(0);
+	}
+	WQ_COUNT = worker;
+	WORKSTEAL = worksteal;
+
+	struct idle_worker *idle = skynet_malloc(sizeof(*idle));
+	SPIN_INIT(idle);
+	ATOM_INIT(&idle->sleep, 0);
+	ATOM_INIT(&idle->spinning, 0);
+	idle->quit = 0;
+	idle->id = skynet_malloc(worker * sizeof(int));
+	I = idle;
+}
+
+#ifndef USE_LOCKFREE_MQ
+
 struct message_queue * 
 skynet_mq_create(uint32_t handle) {
 	struct message_queue *q = skynet_malloc(sizeof(*q));
@@ -89,6 +470,7 @@ skynet_mq_create(uint32_t handle) {
 	q->release = 0;
 	q->overload = 0;
 	q->overload_threshold = MQ_OVERLOAD;
+	q->priority = MQ_PRIORITY_NORMAL;
 	q->queue = skynet_malloc(sizeof(struct skynet_message) * q->cap);
 	q->next = NULL;
 
@@ -103,11 +485,6 @@ _release(struct message_queue *q) {
 	skynet_free(q);
 }
 
-uint32_t 
-skynet_mq_handle(struct message_queue *q) {
-	return q->handle;
-}
-
 int
 skynet_mq_length(struct message_queue *q) {
 	int head, tail,cap;
@@ -125,34 +502,29 @@ skynet_mq_length(struct message_queue *q) {
 }
 
 int
-skynet_mq_overload(struct message_queue *q) {
-	if (q->overload) {
-		int overload = q->overload;
-		q->overload = 0;
-		return overload;
-	} 
-	return 0;
-}
-
-int
-skynet_mq_pop(struct message_queue *q, struct skynet_message *message) {
-	int ret = 1;
+skynet_mq_pop_batch(struct message_queue *q, struct skynet_message *msgs, int max) {
+	int n = 0;
 	SPIN_LOCK(q)
 
-	if (q->head != q->tail) {
-		*message = q->queue[q->head++];
-		ret = 0;
-		int head = q->head;
-		int tail = q->tail;
-		int cap = q->cap;
-
-		if (head >= cap) {
-			q->head = head = 0;
-		}
-		int length = tail - head;
-		if (length < 0) {
-			length += cap;
+	int head = q->head;
+	int tail = q->tail;
+	int cap = q->cap;
+	int length = tail - head;
+	if (length < 0) {
+		length += cap;
+	}
+	if (length > 0) {
+		n = length < max ? length : max;
+		int i;
+		for (i=0;i<n;i++) {
+			msgs[i] = q->queue[head++];
+			if (head >= cap) {
+				head = 0;
+			}
 		}
+		q->head = head;
+		// the same as popping one by one : check the length after the first message popped
+		length -= 1;
 		while (length > q->overload_threshold) {
 			q->overload = length;
 			q->overload_threshold *= 2;
@@ -160,15 +532,12 @@ skynet_mq_pop(struct message_queue *q, struct skynet_message *message) {
 	} else {
 		// reset overload_threshold when queue is empty
 		q->overload_threshold = MQ_OVERLOAD;
-	}
-
-	if (ret) {
 		q->in_global = 0;
 	}
 	
 	SPIN_UNLOCK(q)
 
-	return ret;
+	return n;
 }
 
 static void
@@ -189,6 +558,7 @@ expand_queue(struct message_queue *q) {
 void 
 skynet_mq_push(struct message_queue *q, struct skynet_message *message) {
 	assert(message);
+	STAMP_MESSAGE(message)
 	SPIN_LOCK(q)
 
 	q->queue[q->tail] = *message;
@@ -200,20 +570,18 @@ skynet_mq_push(struct message_queue *q, struct skynet_message *message) {
 		expand_queue(q);
 	}
 
+	int push = 0;
 	if (q->in_global == 0) {
 		q->in_global = MQ_IN_GLOBAL;
-		skynet_globalmq_push(q);
+		push = 1;
 	}
 	
 	SPIN_UNLOCK(q)
-}
 
-void 
-skynet_mq_init() {
-	struct global_queue *q = skynet_malloc(sizeof(*q));
-	memset(q,0,sizeof(*q));
-	SPIN_INIT(q);
-	Q=q;
+	// push it out of the lock, because skynet_globalmq_push may wake up a worker to pop q.
+	if (push) {
+		skynet_globalmq_push(q);
+	}
 }
 
 void 
@@ -221,10 +589,12 @@ skynet_mq_mark_release(struct message_queue *q) {
 	SPIN_LOCK(q)
 	assert(q->release == 0);
 	q->release = 1;
-	if (q->in_global != MQ_IN_GLOBAL) {
+	int push = q->in_global != MQ_IN_GLOBAL;
+	SPIN_UNLOCK(q)
+
+	if (push) {
 		skynet_globalmq_push(q);
 	}
-	SPIN_UNLOCK(q)
 }
 
 static void
@@ -244,7 +614,224 @@ skynet_mq_release(struct message_queue *q, message_drop drop_func, void *ud) {
 		SPIN_UNLOCK(q)
 		_drop_queue(q, drop_func, ud);
 	} else {
-		skynet_globalmq_push(q);
 		SPIN_UNLOCK(q)
+		skynet_globalmq_push(q);
+	}
+}
+
+#else
+
+static struct mq_block *
+block_new() {
+	struct mq_block *b = skynet_malloc(sizeof(*b));
+	int i;
+	ATOM_INIT(&b->next, (uintptr_t)NULL);
+	ATOM_INIT(&b->reserve, 0);
+	b->retired = NULL;
+	for (i=0;i<MQ_BLOCK_SIZE;i++) {
+		ATOM_INIT(&b->slot[i].ready, 0);
+	}
+	return b;
+}
+
+static void
+block_freelist(struct mq_block *b) {
+	while (b) {
+		struct mq_block *next = b->retired;
+		skynet_free(b);
+		b = next;
+	}
+}
+
+struct message_queue * 
+skynet_mq_create(uint32_t handle) {
+	struct message_queue *q = skynet_malloc(sizeof(*q));
+	struct mq_block *b = block_new();
+	q->handle = handle;
+	ATOM_INIT(&q->tail, (uintptr_t)b);
+	ATOM_INIT(&q->writers, 0);
+	ATOM_INIT(&q->pushed, 0);
+	q->head = b;
+	q->head_pos = 0;
+	ATOM_INIT(&q->popped, 0);
+	q->retired = NULL;
+	// See the comment in the spinlock version above.
+	ATOM_INIT(&q->in_global, MQ_IN_GLOBAL);
+	ATOM_INIT(&q->release, 0);
+	q->overload = 0;
+	q->overload_threshold = MQ_OVERLOAD;
+	q->priority = MQ_PRIORITY_NORMAL;
+	q->next = NULL;
+
+	return q;
+}
+
+static void 
+_release(struct message_queue *q) {
+	assert(q->next == NULL);
+	struct mq_block *b = q->head;
+	while (b) {
+		struct mq_block *next = (struct mq_block *)ATOM_LOAD(&b->next);
+		skynet_free(b);
+		b = next;
 	}
+	block_freelist(q->retired);
+	skynet_free(q);
+}
+
+int
+skynet_mq_length(struct message_queue *q) {
+	// pushed is increased after the slot is ready, so it may be less than popped for a while
+	int length = ATOM_LOAD(&q->pushed) - ATOM_LOAD(&q->popped);
+	return length < 0 ? 0 : length;
+}
+
+// The retired block may still be touched by the producers which loaded it as tail before.
+// Free them only when no producer is in skynet_mq_push.
+static void
+retire_block(struct message_queue *q, struct mq_block *b, struct mq_block *next) {
+	while (ATOM_LOAD(&q->tail) == (uintptr_t)b) {
+		ATOM_CAS_POINTER(&q->tail, (uintptr_t)b, (uintptr_t)next);
+	}
+	b->retired = q->retired;
+	q->retired = b;
+	if (ATOM_LOAD(&q->writers) == 0) {
+		block_freelist(q->retired);
+		q->retired = NULL;
+	}
+}
+
+static struct mq_slot *
+head_slot(struct message_queue *q) {
+	if (q->head_pos == MQ_BLOCK_SIZE) {
+		struct mq_block *next = (struct mq_block *)ATOM_LOAD(&q->head->next);
+		if (next == NULL) {
+			return NULL;
+		}
+		retire_block(q, q->head, next);
+		q->head = next;
+		q->head_pos = 0;
+	}
+	struct mq_slot *s = &q->head->slot[q->head_pos];
+	if (ATOM_LOAD(&s->ready)) {
+		return s;
+	}
+	return NULL;
+}
+
+// returns 1 if the queue is taken by the signal
+static inline int
+signal_queue(struct message_queue *q) {
+	return ATOM_FINC(&q->in_global) == 0;
+}
+
+int
+skynet_mq_pop_batch(struct message_queue *q, struct skynet_message *msgs, int max) {
+	struct mq_slot *s = head_slot(q);
+	while (s == NULL) {
+		// reset overload_threshold when queue is empty
+		q->overload_threshold = MQ_OVERLOAD;
+		// The producer publishes the slot before the signal, so the slot of any signal loaded here is ready.
+		int signal = ATOM_LOAD(&q->in_global);
+		s = head_slot(q);
+		if (s == NULL) {
+			// Give the queue up if no signal comes after, and don't touch it any more,
+			// because another worker may take it (and release it) at once.
+			if (ATOM_CAS(&q->in_global, signal, 0)) {
+				return 0;
+			}
+			s = head_slot(q);
+		}
+	}
+	int n = 0;
+	do {
+		msgs[n++] = s->message;
+		++q->head_pos;
+	} while (n < max && (s = head_slot(q)));
+	ATOM_FADD(&q->popped, n);
+
+	int signal = ATOM_LOAD(&q->in_global);
+	if (signal > MQ_SIGNAL_LIMIT) {
+		ATOM_CAS(&q->in_global, signal, MQ_IN_GLOBAL);
+	}
+
+	// the same as popping one by one : check the length after the first message popped
+	int length = skynet_mq_length(q) + n - 1;
+	while (length > q->overload_threshold) {
+		q->overload = length;
+		q->overload_threshold *= 2;
+	}
+
+	return n;
+}
+
+void 
+skynet_mq_push(struct message_queue *q, struct skynet_message *message) {
+	assert(message);
+	STAMP_MESSAGE(message)
+	ATOM_FINC(&q->writers);
+	for (;;) {
+		struct mq_block *b = (struct mq_block *)ATOM_LOAD(&q->tail);
+		int idx = ATOM_FINC(&b->reserve);
+		if (idx < MQ_BLOCK_SIZE) {
+			struct mq_slot *s = &b->slot[idx];
+			s->message = *message;
+			ATOM_STORE(&s->ready, 1);
+			break;
+		}
+		// The block is full, link a new one (or use the one linked by others) and move tail.
+		struct mq_block *next = (struct mq_block *)ATOM_LOAD(&b->next);
+		if (next == NULL) {
+			struct mq_block *nb = block_new();
+			if (ATOM_CAS_POINTER(&b->next, (uintptr_t)NULL, (uintptr_t)nb)) {
+				next = nb;
+			} else {
+				skynet_free(nb);
+				continue;
+			}
+		}
+		ATOM_CAS_POINTER(&q->tail, (uintptr_t)b, (uintptr_t)next);
+	}
+	ATOM_FINC(&q->pushed);
+	ATOM_FDEC(&q->writers);
+
+	if (signal_queue(q)) {
+		skynet_globalmq_push(q);
+	}
+}
+
+void 
+skynet_mq_mark_release(struct message_queue *q) {
+	int release = ATOM_LOAD(&q->release);
+	assert(release == 0);
+	ATOM_STORE(&q->release, 1);
+	if (signal_queue(q)) {
+		skynet_globalmq_push(q);
+	}
+}
+
+static void
+_drop_queue(struct message_queue *q, message_drop drop_func, void *ud) {
+	struct skynet_message msg;
+	while(!skynet_mq_pop(q, &msg)) {
+		drop_func(&msg, ud);
+	}
+	_release(q);
+}
+
+void 
+skynet_mq_release(struct message_queue *q, message_drop drop_func, void *ud) {
+	// The caller owns the queue (in_global is set), so mark_release can't push it again.
+	if (ATOM_LOAD(&q->release)) {
+		_drop_queue(q, drop_func, ud);
+	} else {
+		skynet_globalmq_push(q);
+	}
+}
+
+#endif
+
+int
+skynet_mq_pop(struct message_queue *q, struct skynet_message *message) {
+	return skynet_mq_pop_batch(q, message, 1) == 0;
 }
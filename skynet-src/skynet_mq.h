@@ -4,16 +4,34 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#define MESSAGE_INLINE_SIZE 32
+
 struct skynet_message {
 	uint32_t source;
 	int session;
-	void * data;
+	union {
+		void * data;
+		char payload[MESSAGE_INLINE_SIZE];	// see MESSAGE_INLINE
+	};
 	size_t sz;
+#ifdef USE_LATENCY_STAT
+	uint64_t stamp;	// the time pushed into the queue
+#endif
 };
 
+#define MQ_PRIORITY_HIGH 0
+#define MQ_PRIORITY_NORMAL 1
+#define MQ_PRIORITY_LOW 2
+#define MQ_PRIORITY_LEVEL 3
+
 // type is encoding in skynet_message.sz high 8bit
 #define MESSAGE_TYPE_MASK (SIZE_MAX >> 8)
 #define MESSAGE_TYPE_SHIFT ((sizeof(size_t)-1) * 8)
+// the bit next to the type : the data (less than MESSAGE_INLINE_SIZE bytes, with '\0' ended) is stored in payload
+#define MESSAGE_INLINE ((size_t)1 << (MESSAGE_TYPE_SHIFT - 1))
+// the data is a refcounted buffer, see skynet_shared_new()
+#define MESSAGE_SHARED ((size_t)1 << (MESSAGE_TYPE_SHIFT - 2))
+#define MESSAGE_SIZE_MASK (MESSAGE_SHARED - 1)
 
 struct message_queue;
 
@@ -30,12 +48,23 @@ uint32_t skynet_mq_handle(struct message_queue *);
 
 // 0 for success
 int skynet_mq_pop(struct message_queue *q, struct skynet_message *message);
+// pop at most max messages into msgs under one lock, returns the number popped (0 means empty)
+int skynet_mq_pop_batch(struct message_queue *q, struct skynet_message *msgs, int max);
 void skynet_mq_push(struct message_queue *q, struct skynet_message *message);
 
 // return the length of message queue, for debug
 int skynet_mq_length(struct message_queue *q);
 int skynet_mq_overload(struct message_queue *q);
 
-void skynet_mq_init();
+void skynet_mq_setpriority(struct message_queue *q, int priority);
+int skynet_mq_priority(struct message_queue *q);
+
+// worksteal : each worker thread owns a local run queue and steals from others
+void skynet_mq_init(int worker, int worksteal, int numa);
+void skynet_mq_register_worker(int id);
+
+// park the worker until a queue is pushed into run queues
+void skynet_globalmq_wait(void);
+void skynet_globalmq_exit(void);
 
 #endif
@@ -10,6 +10,7 @@
 #include "skynet_monitor.h"
 #include "skynet_imp.h"
 #include "skynet_log.h"
+#include "skynet_histogram.h"
 #include "spinlock.h"
 #include "atomic.h"
 
@@ -39,6 +40,34 @@
 
 #endif
 
+#ifdef USE_LATENCY_STAT
+
+// wait : from skynet_mq_push to dispatch , handle : the callback , in microsec
+#define LATENCY_DECL struct skynet_histogram wait_time; struct skynet_histogram handle_time;
+#define LATENCY_INIT(ctx) skynet_histogram_init(&ctx->wait_time); skynet_histogram_init(&ctx->handle_time);
+#define LATENCY_BEGIN(ctx, msg) uint64_t latency_start = skynet_clock_time(); skynet_histogram_record(&ctx->wait_time, latency_start - msg->stamp);
+#define LATENCY_END(ctx) skynet_histogram_record(&ctx->handle_time, skynet_clock_time() - latency_start);
+
+#else
+
+#define LATENCY_DECL
+#define LATENCY_INIT(ctx)
+#define LATENCY_BEGIN(ctx, msg)
+#define LATENCY_END(ctx)
+
+#endif
+
+// The names resolved by skynet_sendname, allocated on first use
+#define NAME_CACHE_SIZE 8
+#define NAME_CACHE_LENGTH 20
+
+struct name_cache {
+	uint32_t hash;
+	uint32_t handle;	// 0 means empty
+	uint32_t version;	// see skynet_handle_nameversion
+	char name[NAME_CACHE_LENGTH];
+};
+
 struct skynet_context {
 	void * instance;
 	struct skynet_module * mod;
@@ -48,6 +77,7 @@ struct skynet_context {
 	ATOM_POINTER logfile;
 	uint64_t cpu_cost;	// in microsec
 	uint64_t cpu_start;	// in microsec
+	uint64_t cpu_avg;	// moving average of the cost per message, in 1/16 microsec
 	char result[32];
 	uint32_t handle;
 	int session_id;
@@ -56,8 +86,11 @@ struct skynet_context {
 	bool init;
 	bool endless;
 	bool profile;
+	bool inline_msg;	// accept inline message, see skynet_callback_inline
+	struct name_cache *name_cache;
 
 	CHECKCALLING_DECL
+	LATENCY_DECL
 };
 
 struct skynet_node {
@@ -66,6 +99,7 @@ struct skynet_node {
 	uint32_t monitor_exit;
 	pthread_key_t handle_key;
 	bool profile;	// default is on
+	int dispatch_budget;	// in microsec, 0 means use the weight of worker
 };
 
 static struct skynet_node G_NODE;
@@ -107,6 +141,45 @@ id_to_hex(char * str, uint32_t id) {
 	str[9] = '\0';
 }
 
+struct shared_buffer {
+	union {
+		ATOM_INT ref;
+		uint64_t align;
+	};
+	// data follows
+};
+
+static inline struct shared_buffer *
+shared_buffer(void * msg) {
+	return (struct shared_buffer *)((char *)msg - sizeof(struct shared_buffer));
+}
+
+void *
+skynet_shared_new(size_t sz) {
+	struct shared_buffer * b = skynet_malloc(sizeof(*b) + sz + 1);
+	ATOM_INIT(&b->ref, 1);
+	char * msg = (char *)(b+1);
+	msg[sz] = '\0';
+	return msg;
+}
+
+void
+skynet_shared_release(void * msg) {
+	struct shared_buffer * b = shared_buffer(msg);
+	if (ATOM_FDEC(&b->ref) == 1) {
+		skynet_free(b);
+	}
+}
+
+static void
+free_message(struct skynet_message *msg) {
+	if (msg->sz & MESSAGE_SHARED) {
+		skynet_shared_release(msg->data);
+	} else if (!(msg->sz & MESSAGE_INLINE)) {
+		skynet_free(msg->data);
+	}
+}
+
 struct drop_t {
 	uint32_t handle;
 };
@@ -114,7 +187,7 @@ struct drop_t {
 static void
 drop_message(struct skynet_message *msg, void *ud) {
 	struct drop_t *d = ud;
-	skynet_free(msg->data);
+	free_message(msg);
 	uint32_t source = d->handle;
 	assert(source);
 	// report error to the message source
@@ -123,6 +196,11 @@ drop_message(struct skynet_message *msg, void *ud) {
 
 uint32_t
 skynet_context_new(const char * name, const char *param) {
+	return skynet_context_new_priority(name, param, MQ_PRIORITY_NORMAL);
+}
+
+uint32_t
+skynet_context_new_priority(const char * name, const char *param, int priority) {
 	struct skynet_module * mod = skynet_module_query(name);
 
 	if (mod == NULL)
@@ -133,6 +211,7 @@ skynet_context_new(const char * name, const char *param) {
 		return 0;
 	struct skynet_context * ctx = skynet_malloc(sizeof(*ctx));
 	CHECKCALLING_INIT(ctx)
+	LATENCY_INIT(ctx)
 
 	ctx->mod = mod;
 	ctx->instance = inst;
@@ -144,9 +223,12 @@ skynet_context_new(const char * name, const char *param) {
 
 	ctx->init = false;
 	ctx->endless = false;
+	ctx->inline_msg = false;
+	ctx->name_cache = NULL;
 
 	ctx->cpu_cost = 0;
 	ctx->cpu_start = 0;
+	ctx->cpu_avg = 0;
 	ctx->message_count = 0;
 	ctx->profile = G_NODE.profile;
 	// Should set to 0 first to avoid skynet_handle_retireall get an uninitialized handle
@@ -154,6 +236,8 @@ skynet_context_new(const char * name, const char *param) {
 	const uint32_t handle = skynet_handle_register(ctx);
 	ctx->handle = handle;
 	struct message_queue * queue = ctx->queue = skynet_mq_create(handle);
+	// set before the queue is pushed into run queues, so the first message is scheduled at this level
+	skynet_mq_setpriority(queue, priority);
 	// init function maybe use ctx->handle, so it must init at last
 	context_inc();
 
@@ -193,6 +277,17 @@ skynet_context_grab(struct skynet_context *ctx) {
 	ATOM_FINC(&ctx->ref);
 }
 
+int
+skynet_context_trygrab(struct skynet_context *ctx) {
+	for (;;) {
+		int ref = ATOM_LOAD(&ctx->ref);
+		if (ref == 0)
+			return 0;
+		if (ATOM_CAS(&ctx->ref, ref, ref + 1))
+			return 1;
+	}
+}
+
 void
 skynet_context_reserve(struct skynet_context *ctx) {
 	skynet_context_grab(ctx);
@@ -210,7 +305,9 @@ delete_context(struct skynet_context *ctx) {
 	skynet_module_instance_release(ctx->mod, ctx->instance);
 	skynet_mq_mark_release(ctx->queue);
 	CHECKCALLING_DESTROY(ctx)
-	skynet_free(ctx);
+	skynet_free(ctx->name_cache);
+	// skynet_handle_grab may still read it
+	skynet_handle_free(ctx);
 	context_dec();
 }
 
@@ -258,23 +355,36 @@ dispatch_message(struct skynet_context *ctx, struct skynet_message *msg) {
 	CHECKCALLING_BEGIN(ctx)
 	pthread_setspecific(G_NODE.handle_key, (void *)(uintptr_t)(ctx->handle));
 	int type = msg->sz >> MESSAGE_TYPE_SHIFT;
-	size_t sz = msg->sz & MESSAGE_TYPE_MASK;
+	size_t sz = msg->sz & MESSAGE_SIZE_MASK;
+	void * data = (msg->sz & MESSAGE_INLINE) ? msg->payload : msg->data;
+	if ((msg->sz & (MESSAGE_INLINE | MESSAGE_SHARED)) && !ctx->inline_msg) {
+		// the callback may keep the message (changed after the message pushed), so give it a copy
+		void * copy = skynet_malloc(sz+1);
+		memcpy(copy, data, sz+1);
+		free_message(msg);
+		msg->data = data = copy;
+		msg->sz &= ~(MESSAGE_INLINE | MESSAGE_SHARED);
+	}
 	FILE *f = (FILE *)ATOM_LOAD(&ctx->logfile);
 	if (f) {
-		skynet_log_output(f, msg->source, type, msg->session, msg->data, sz);
+		skynet_log_output(f, msg->source, type, msg->session, data, sz);
 	}
 	++ctx->message_count;
+	LATENCY_BEGIN(ctx, msg)
 	int reserve_msg;
 	if (ctx->profile) {
 		ctx->cpu_start = skynet_thread_time();
-		reserve_msg = ctx->cb(ctx, ctx->cb_ud, type, msg->session, msg->source, msg->data, sz);
+		reserve_msg = ctx->cb(ctx, ctx->cb_ud, type, msg->session, msg->source, data, sz);
 		uint64_t cost_time = skynet_thread_time() - ctx->cpu_start;
 		ctx->cpu_cost += cost_time;
+		// avg = avg * 7/8 + cost * 1/8 , avg is in 1/16 microsec
+		ctx->cpu_avg = ctx->cpu_avg - (ctx->cpu_avg >> 3) + cost_time * 2;
 	} else {
-		reserve_msg = ctx->cb(ctx, ctx->cb_ud, type, msg->session, msg->source, msg->data, sz);
+		reserve_msg = ctx->cb(ctx, ctx->cb_ud, type, msg->session, msg->source, data, sz);
 	}
+	LATENCY_END(ctx)
 	if (!reserve_msg) {
-		skynet_free(msg->data);
+		free_message(msg);
 	}
 	CHECKCALLING_END(ctx)
 }
@@ -289,6 +399,34 @@ skynet_context_dispatchall(struct skynet_context * ctx) {
 	}
 }
 
+#define DISPATCH_BATCH 32
+// The floor of the estimated cost per message (in 1/16 microsec). The average is 0 for a new service,
+// and stays 0 for the handlers cheaper than the 1us resolution of skynet_thread_time.
+#define DISPATCH_MIN_COST 16
+
+// How many messages to dispatch in one turn (at least 1).
+static int
+dispatch_count(struct skynet_context *ctx, struct message_queue *q, int weight) {
+	int budget = G_NODE.dispatch_budget;
+	if (budget > 0 && ctx->profile) {
+		// adaptive : drain the queue, but the estimated cost should not exceed the budget.
+		// The budget of the worker is 1/2^weight, the workers of weight -1 take the whole budget as weight 0.
+		int n = skynet_mq_length(q);
+		uint64_t avg = ctx->cpu_avg > DISPATCH_MIN_COST ? ctx->cpu_avg : DISPATCH_MIN_COST;
+		uint64_t limit = ((uint64_t)budget * 16 / avg) >> (weight > 0 ? weight : 0);
+		if (limit < n) {
+			n = (int)limit;
+		}
+		return n > 0 ? n : 1;
+	}
+	if (weight >= 0) {
+		// the first message, and 1/2^weight of the rest
+		int n = (skynet_mq_length(q) - 1) >> weight;
+		return n > 0 ? n : 1;
+	}
+	return 1;
+}
+
 struct message_queue *
 skynet_context_message_dispatch(struct skynet_monitor *sm, struct message_queue *q, int weight) {
 	if (q == NULL) {
@@ -306,31 +444,32 @@ skynet_context_message_dispatch(struct skynet_monitor *sm, struct message_queue
 		return skynet_globalmq_pop();
 	}
 
-	int i,n=1;
-	struct skynet_message msg;
+	int i,n = dispatch_count(ctx, q, weight);
+	struct skynet_message msg[DISPATCH_BATCH];
 
-	for (i=0;i<n;i++) {
-		if (skynet_mq_pop(q,&msg)) {
+	while (n > 0) {
+		int batch = skynet_mq_pop_batch(q, msg, n < DISPATCH_BATCH ? n : DISPATCH_BATCH);
+		if (batch == 0) {
 			skynet_context_release(ctx);
 			return skynet_globalmq_pop();
-		} else if (i==0 && weight >= 0) {
-			n = skynet_mq_length(q);
-			n >>= weight;
 		}
+		n -= batch;
 		int overload = skynet_mq_overload(q);
 		if (overload) {
 			skynet_error(ctx, "error: May overload, message queue length = %d", overload);
 		}
 
-		skynet_monitor_trigger(sm, msg.source , handle);
+		for (i=0;i<batch;i++) {
+			skynet_monitor_trigger(sm, msg[i].source , handle);
 
-		if (ctx->cb == NULL) {
-			skynet_free(msg.data);
-		} else {
-			dispatch_message(ctx, &msg);
-		}
+			if (ctx->cb == NULL) {
+				free_message(&msg[i]);
+			} else {
+				dispatch_message(ctx, &msg[i]);
+			}
 
-		skynet_monitor_trigger(sm, 0,0);
+			skynet_monitor_trigger(sm, 0,0);
+		}
 	}
 
 	assert(q == ctx->queue);
@@ -400,6 +539,15 @@ cmd_timeout(struct skynet_context * context, const char * param) {
 	return context->result;
 }
 
+static const char *
+cmd_timeout_ms(struct skynet_context * context, const char * param) {
+	int ti = strtol(param, NULL, 10);
+	int session = skynet_context_newsession(context);
+	skynet_timeout_ms(context->handle, ti, session);
+	sprintf(context->result, "%d", session);
+	return context->result;
+}
+
 static const char *
 cmd_reg(struct skynet_context * context, const char * param) {
 	if (param == NULL || param[0] == '\0') {
@@ -475,6 +623,19 @@ cmd_kill(struct skynet_context * context, const char * param) {
 	return NULL;
 }
 
+static const char * priority_name[MQ_PRIORITY_LEVEL] = { "high", "normal", "low" };
+
+static int
+priority_level(const char * name) {
+	int i;
+	for (i=0;i<MQ_PRIORITY_LEVEL;i++) {
+		if (strcmp(name, priority_name[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+// LAUNCH [-high|-normal|-low] module args
 static const char *
 cmd_launch(struct skynet_context * context, const char * param) {
 	size_t sz = strlen(param);
@@ -482,8 +643,19 @@ cmd_launch(struct skynet_context * context, const char * param) {
 	strcpy(tmp,param);
 	char * args = tmp;
 	char * mod = strsep(&args, " \t\r\n");
+	int priority = MQ_PRIORITY_NORMAL;
+	if (mod[0] == '-') {
+		priority = priority_level(mod+1);
+		if (priority < 0) {
+			skynet_error(context, "error: Invalid priority %s", mod+1);
+			return NULL;
+		}
+		if (args == NULL)
+			return NULL;
+		mod = strsep(&args, " \t\r\n");
+	}
 	args = strsep(&args, "\r\n");
-	const uint32_t handle = skynet_context_new(mod,args);
+	const uint32_t handle = skynet_context_new_priority(mod,args,priority);
 	if (handle == 0) {
 		return NULL;
 	} else {
@@ -545,6 +717,40 @@ cmd_monitor(struct skynet_context * context, const char * param) {
 	return NULL;
 }
 
+#ifdef USE_LATENCY_STAT
+
+// latency : 1 if enabled , wait/handle [percentile] : the latency in microsec, the average without percentile
+static int
+latency_stat(struct skynet_context * context, const char * param) {
+	struct skynet_histogram * h;
+	if (strcmp(param, "latency") == 0) {
+		strcpy(context->result, "1");
+		return 1;
+	} else if (strncmp(param, "wait", 4) == 0) {
+		h = &context->wait_time;
+		param += 4;
+	} else if (strncmp(param, "handle", 6) == 0) {
+		h = &context->handle_time;
+		param += 6;
+	} else {
+		return 0;
+	}
+	uint64_t v;
+	if (*param == '\0') {
+		v = h->count ? h->sum / h->count : 0;
+	} else {
+		v = skynet_histogram_percentile(h, strtod(param, NULL));
+	}
+	sprintf(context->result, "%llu", (unsigned long long)v);
+	return 1;
+}
+
+#else
+
+#define latency_stat(context, param) 0
+
+#endif
+
 static const char *
 cmd_stat(struct skynet_context * context, const char * param) {
 	if (strcmp(param, "mqlen") == 0) {
@@ -570,12 +776,53 @@ cmd_stat(struct skynet_context * context, const char * param) {
 		}
 	} else if (strcmp(param, "message") == 0) {
 		sprintf(context->result, "%zu", context->message_count);
-	} else {
+	} else if (strcmp(param, "slot") == 0) {
+		sprintf(context->result, "%d", skynet_handle_slotsize());
+	} else if (strcmp(param, "slotreclaim") == 0) {
+		sprintf(context->result, "%zu", skynet_handle_slotreclaimed());
+	} else if (!latency_stat(context, param)) {
 		context->result[0] = '\0';
 	}
 	return context->result;
 }
 
+// PRIORITY [address] [high|normal|low] , returns the priority after setting
+static const char *
+cmd_priority(struct skynet_context * context, const char * param) {
+	if (param == NULL) {
+		param = "";
+	}
+	size_t sz = strlen(param);
+	char addr[sz+1];
+	char level[sz+1];
+	addr[0] = level[0] = '\0';
+	sscanf(param, "%s %s", addr, level);
+	if (addr[0] != ':' && addr[0] != '.') {
+		strcpy(level, addr);
+		addr[0] = '\0';
+	}
+	uint32_t handle = context->handle;
+	if (addr[0]) {
+		handle = tohandle(context, addr);
+		if (handle == 0)
+			return NULL;
+	}
+	struct skynet_context * ctx = skynet_handle_grab(handle);
+	if (ctx == NULL)
+		return NULL;
+	if (level[0]) {
+		int i = priority_level(level);
+		if (i < 0) {
+			skynet_error(context, "error: Invalid priority %s", level);
+		} else {
+			skynet_mq_setpriority(ctx->queue, i);
+		}
+	}
+	strcpy(context->result, priority_name[skynet_mq_priority(ctx->queue)]);
+	skynet_context_release(ctx);
+	return context->result;
+}
+
 static const char *
 cmd_logon(struct skynet_context * context, const char * param) {
 	uint32_t handle = tohandle(context, param);
@@ -640,6 +887,7 @@ cmd_signal(struct skynet_context * context, const char * param) {
 
 static struct command_func cmd_funcs[] = {
 	{ "TIMEOUT", cmd_timeout },
+	{ "TIMEOUTMS", cmd_timeout_ms },
 	{ "REG", cmd_reg },
 	{ "QUERY", cmd_query },
 	{ "NAME", cmd_name },
@@ -655,6 +903,7 @@ static struct command_func cmd_funcs[] = {
 	{ "LOGON", cmd_logon },
 	{ "LOGOFF", cmd_logoff },
 	{ "SIGNAL", cmd_signal },
+	{ "PRIORITY", cmd_priority },
 	{ NULL, NULL },
 };
 
@@ -692,15 +941,61 @@ _filter_args(struct skynet_context * context, int type, int *session, void ** da
 	*sz |= (size_t)type << MESSAGE_TYPE_SHIFT;
 }
 
+// The small message is stored inline (without malloc) and the shared message is not copied, if the destination accepts it.
+static int
+push_message(uint32_t destination, struct skynet_message *smsg, void * data, size_t sz, int needcopy, int shared) {
+	struct skynet_context * ctx = skynet_handle_grab(destination);
+	if (ctx == NULL) {
+		return -1;
+	}
+	size_t len = sz & MESSAGE_TYPE_MASK;
+	if (shared && len >= MESSAGE_INLINE_SIZE && ctx->inline_msg) {
+		ATOM_FINC(&shared_buffer(data)->ref);
+		smsg->data = data;
+		smsg->sz = sz | MESSAGE_SHARED;
+	} else if (data && len < MESSAGE_INLINE_SIZE && ctx->inline_msg) {
+		memcpy(smsg->payload, data, len);
+		smsg->payload[len] = '\0';
+		smsg->sz = sz | MESSAGE_INLINE;
+		if (!needcopy) {
+			skynet_free(data);
+		}
+	} else {
+		if (needcopy && data) {
+			char * msg = skynet_malloc(len+1);
+			memcpy(msg, data, len);
+			msg[len] = '\0';
+			data = msg;
+		}
+		smsg->data = data;
+		smsg->sz = sz;
+	}
+	skynet_mq_push(ctx->queue, smsg);
+	skynet_context_release(ctx);
+
+	return 0;
+}
+
 int
 skynet_send(struct skynet_context * context, uint32_t source, uint32_t destination , int type, int session, void * data, size_t sz) {
-	if ((sz & MESSAGE_TYPE_MASK) != sz) {
+	int shared = type & PTYPE_TAG_SHARED;
+	if (shared) {
+		// the caller keeps its reference
+		type &= ~PTYPE_TAG_DONTCOPY;
+	}
+	if (sz > MESSAGE_SIZE_MASK) {
 		skynet_error(context, "error: The message to %x is too large", destination);
 		if (type & PTYPE_TAG_DONTCOPY) {
 			skynet_free(data);
 		}
 		return -2;
 	}
+	int needcopy = !(type & PTYPE_TAG_DONTCOPY);
+	int local = destination != 0 && !skynet_harbor_message_isremote(destination);
+	if (local) {
+		// copy it in push_message, the small message may not need malloc
+		type |= PTYPE_TAG_DONTCOPY;
+	}
 	_filter_args(context, type, &session, (void **)&data, &sz);
 
 	if (source == 0) {
@@ -716,7 +1011,7 @@ skynet_send(struct skynet_context * context, uint32_t source, uint32_t destinati
 
 		return session;
 	}
-	if (skynet_harbor_message_isremote(destination)) {
+	if (!local) {
 		struct remote_message * rmsg = skynet_malloc(sizeof(*rmsg));
 		rmsg->destination.handle = destination;
 		rmsg->message = data;
@@ -727,17 +1022,44 @@ skynet_send(struct skynet_context * context, uint32_t source, uint32_t destinati
 		struct skynet_message smsg;
 		smsg.source = source;
 		smsg.session = session;
-		smsg.data = data;
-		smsg.sz = sz;
 
-		if (skynet_context_push(destination, &smsg)) {
-			skynet_free(data);
+		if (push_message(destination, &smsg, data, sz, needcopy, shared)) {
+			if (!needcopy) {
+				skynet_free(data);
+			}
 			return -1;
 		}
 	}
 	return session;
 }
 
+static uint32_t
+cache_findname(struct skynet_context * context, const char * name) {
+	size_t sz = strlen(name);
+	if (sz >= NAME_CACHE_LENGTH) {
+		return skynet_handle_findname(name);
+	}
+	if (context->name_cache == NULL) {
+		context->name_cache = skynet_malloc(NAME_CACHE_SIZE * sizeof(struct name_cache));
+		memset(context->name_cache, 0, NAME_CACHE_SIZE * sizeof(struct name_cache));
+	}
+	uint32_t hash = skynet_handle_namehash(name);
+	// read the version before findname, any removal after it invalidates the cache
+	uint32_t version = skynet_handle_nameversion();
+	struct name_cache * c = &context->name_cache[hash & (NAME_CACHE_SIZE-1)];
+	if (c->handle && c->hash == hash && c->version == version && memcmp(c->name, name, sz+1) == 0) {
+		return c->handle;
+	}
+	uint32_t handle = skynet_handle_findname_hash(name, hash);
+	if (handle) {
+		c->hash = hash;
+		c->handle = handle;
+		c->version = version;
+		memcpy(c->name, name, sz+1);
+	}
+	return handle;
+}
+
 int
 skynet_sendname(struct skynet_context * context, uint32_t source, const char * addr , int type, int session, void * data, size_t sz) {
 	if (source == 0) {
@@ -747,7 +1069,7 @@ skynet_sendname(struct skynet_context * context, uint32_t source, const char * a
 	if (addr[0] == ':') {
 		des = strtoul(addr+1, NULL, 16);
 	} else if (addr[0] == '.') {
-		des = skynet_handle_findname(addr + 1);
+		des = cache_findname(context, addr + 1);
 		if (des == 0) {
 			if (type & PTYPE_TAG_DONTCOPY) {
 				skynet_free(data);
@@ -778,6 +1100,38 @@ skynet_sendname(struct skynet_context * context, uint32_t source, const char * a
 	return skynet_send(context, source, des, type, session, data, sz);
 }
 
+int
+skynet_sendmulti(struct skynet_context * context, const uint32_t *destinations, int n, int type, void * data, size_t sz) {
+	if (sz > MESSAGE_SIZE_MASK) {
+		skynet_error(context, "error: The multi message is too large");
+		if ((type & (PTYPE_TAG_DONTCOPY | PTYPE_TAG_SHARED)) == PTYPE_TAG_DONTCOPY) {
+			skynet_free(data);
+		}
+		return -2;
+	}
+	void * msg = data;
+	if (!(type & PTYPE_TAG_SHARED)) {
+		// allocate once for all the destinations
+		msg = skynet_shared_new(sz);
+		memcpy(msg, data, sz);
+		if (type & PTYPE_TAG_DONTCOPY) {
+			skynet_free(data);
+		}
+	}
+	type = (type & 0xff) | PTYPE_TAG_SHARED;
+	int i;
+	int count = 0;
+	for (i=0;i<n;i++) {
+		if (skynet_send(context, 0, destinations[i], type, 0, msg, sz) >= 0) {
+			++count;
+		}
+	}
+	if (msg != data) {
+		skynet_shared_release(msg);
+	}
+	return count;
+}
+
 uint32_t
 skynet_context_handle(struct skynet_context *ctx) {
 	return ctx->handle;
@@ -787,6 +1141,14 @@ void
 skynet_callback(struct skynet_context * context, void *ud, skynet_cb cb) {
 	context->cb = cb;
 	context->cb_ud = ud;
+	// Without callback the messages are dropped, never kept. The messages queued are copied out
+	// by dispatch_message if the callback set later doesn't accept inline.
+	context->inline_msg = (cb == NULL);
+}
+
+void
+skynet_callback_inline(struct skynet_context * context, int enable) {
+	context->inline_msg = enable ? true : false;
 }
 
 void
@@ -828,3 +1190,8 @@ void
 skynet_profile_enable(int enable) {
 	G_NODE.profile = (bool)enable;
 }
+
+void
+skynet_dispatch_budget(int budget) {
+	G_NODE.dispatch_budget = budget;
+}
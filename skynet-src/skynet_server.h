@@ -9,7 +9,9 @@ struct skynet_message;
 struct skynet_monitor;
 
 uint32_t skynet_context_new(const char * name, const char * parm);
+uint32_t skynet_context_new_priority(const char * name, const char * parm, int priority);	// priority is MQ_PRIORITY_*
 void skynet_context_grab(struct skynet_context *);
+int skynet_context_trygrab(struct skynet_context *);	// grab it if it's not released, returns 0 if failed
 void skynet_context_reserve(struct skynet_context *ctx);
 void skynet_context_release(struct skynet_context *);
 uint32_t skynet_context_handle(struct skynet_context *);
@@ -27,5 +29,6 @@ void skynet_globalexit(void);
 void skynet_initthread(int m);
 
 void skynet_profile_enable(int enable);
+void skynet_dispatch_budget(int budget);	// in microsec, 0 means use the weight of worker
 
 #endif
@@ -5,6 +5,7 @@
 #include "skynet_server.h"
 #include "skynet_mq.h"
 #include "skynet_harbor.h"
+#include "skynet_handle.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -14,8 +15,8 @@
 static struct socket_server * SOCKET_SERVER = NULL;
 
 void 
-skynet_socket_init() {
-	SOCKET_SERVER = socket_server_create(skynet_now());
+skynet_socket_init(int poller) {
+	SOCKET_SERVER = socket_server_create(skynet_now(), poller);
 }
 
 void
@@ -34,6 +35,24 @@ skynet_socket_updatetime() {
 	socket_server_updatetime(SOCKET_SERVER, skynet_now());
 }
 
+void
+skynet_socket_freebuffer(void *buffer, int sz) {
+	if (SOCKET_SERVER) {
+		socket_server_freebuffer(SOCKET_SERVER, buffer, sz);
+	} else {
+		skynet_free(buffer);
+	}
+}
+
+void
+skynet_socket_poolstat(struct socket_pool_stat *stat) {
+	if (SOCKET_SERVER) {
+		socket_server_poolstat(SOCKET_SERVER, stat);
+	} else {
+		memset(stat, 0, sizeof(*stat));
+	}
+}
+
 // mainloop thread
 static void
 forward_message(int type, bool padding, struct socket_message * result) {
@@ -70,18 +89,25 @@ forward_message(int type, bool padding, struct socket_message * result) {
 	if (skynet_context_push((uint32_t)result->opaque, &message)) {
 		// todo: report somewhere to close socket
 		// don't call skynet_socket_close here (It will block mainloop)
-		skynet_free(sm->buffer);
+		if (type == SKYNET_SOCKET_TYPE_DATA) {
+			socket_server_freebuffer(SOCKET_SERVER, sm->buffer, sm->ud);
+		} else {
+			skynet_free(sm->buffer);
+		}
 		skynet_free(sm);
 	}
 }
 
 int 
-skynet_socket_poll() {
+skynet_socket_poll(int poller) {
 	struct socket_server *ss = SOCKET_SERVER;
 	assert(ss);
 	struct socket_message result;
 	int more = 1;
-	int type = socket_server_poll(ss, &result, &more);
+	// socket_server_poll may block, and it doesn't read handles (except skynet_error, which works offline)
+	skynet_handle_offline();
+	int type = socket_server_poll(ss, poller, &result, &more);
+	skynet_handle_online();
 	switch (type) {
 	case SOCKET_EXIT:
 		return 0;
@@ -132,6 +158,12 @@ skynet_socket_listen(struct skynet_context *ctx, const char *host, int port, int
 	return socket_server_listen(SOCKET_SERVER, source, host, port, backlog);
 }
 
+int 
+skynet_socket_reuseport_listen(struct skynet_context *ctx, const char *host, int port, int backlog) {
+	uint32_t source = skynet_context_handle(ctx);
+	return socket_server_reuseport_listen(SOCKET_SERVER, source, host, port, backlog);
+}
+
 int 
 skynet_socket_connect(struct skynet_context *ctx, const char *host, int port) {
 	uint32_t source = skynet_context_handle(ctx);
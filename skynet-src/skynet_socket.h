@@ -21,15 +21,19 @@ struct skynet_socket_message {
 	char * buffer;
 };
 
-void skynet_socket_init();
+void skynet_socket_init(int poller);
 void skynet_socket_exit();
 void skynet_socket_free();
-int skynet_socket_poll();
+int skynet_socket_poll(int poller);
 void skynet_socket_updatetime();
+// give the buffer of SKYNET_SOCKET_TYPE_DATA (sz is the ud of message) back to the pool
+void skynet_socket_freebuffer(void *buffer, int sz);
+void skynet_socket_poolstat(struct socket_pool_stat *stat);
 
 int skynet_socket_sendbuffer(struct skynet_context *ctx, struct socket_sendbuffer *buffer);
 int skynet_socket_sendbuffer_lowpriority(struct skynet_context *ctx, struct socket_sendbuffer *buffer);
 int skynet_socket_listen(struct skynet_context *ctx, const char *host, int port, int backlog);
+int skynet_socket_reuseport_listen(struct skynet_context *ctx, const char *host, int port, int backlog);
 int skynet_socket_connect(struct skynet_context *ctx, const char *host, int port);
 int skynet_socket_bind(struct skynet_context *ctx, int fd);
 void skynet_socket_close(struct skynet_context *ctx, int id);
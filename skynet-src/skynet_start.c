@@ -9,6 +9,8 @@
 #include "skynet_socket.h"
 #include "skynet_daemon.h"
 #include "skynet_harbor.h"
+#include "skynet_affinity.h"
+#include "atomic.h"
 
 #include <pthread.h>
 #include <unistd.h>
@@ -21,16 +23,18 @@
 struct monitor {
 	int count;
 	struct skynet_monitor ** m;
-	pthread_cond_t cond;
-	pthread_mutex_t mutex;
-	int sleep;
 	int quit;
+	int socket_cpu;
+	int timer_cpu;
+	int numa;
+	ATOM_INT ready;
 };
 
 struct worker_parm {
 	struct monitor *m;
 	int id;
 	int weight;
+	int cpu;
 };
 
 static volatile int SIG = 0;
@@ -53,27 +57,30 @@ create_thread(pthread_t *thread, void *(*start_routine) (void *), void *arg) {
 }
 
 static void
-wakeup(struct monitor *m, int busy) {
-	if (m->sleep >= m->count - busy) {
-		// signal sleep worker, "spurious wakeup" is harmless
-		pthread_cond_signal(&m->cond);
+bind_cpu(const char *name, int cpu) {
+	if (cpu >= 0 && skynet_affinity_bind(cpu)) {
+		skynet_error(NULL, "error: Can't bind %s thread to cpu %d", name, cpu);
 	}
 }
 
 static void *
 thread_socket(void *p) {
-	struct monitor * m = p;
+	struct worker_parm *wp = p;
+	struct monitor * m = wp->m;
+	// socket_cpu is for the first socket thread
+	if (wp->id == 0) {
+		bind_cpu("socket", m->socket_cpu);
+	}
 	skynet_initthread(THREAD_SOCKET);
 	skynet_handle_register_thread();
 	for (;;) {
-		int r = skynet_socket_poll();
+		int r = skynet_socket_poll(wp->id);
 		if (r==0)
 			break;
 		if (r<0) {
 			CHECK_ABORT
 			continue;
 		}
-		wakeup(m,0);
 	}
 	return NULL;
 }
@@ -85,8 +92,6 @@ free_monitor(struct monitor *m) {
 	for (i=0;i<n;i++) {
 		skynet_monitor_delete(m->m[i]);
 	}
-	pthread_mutex_destroy(&m->mutex);
-	pthread_cond_destroy(&m->cond);
 	skynet_free(m->m);
 	skynet_free(m);
 }
@@ -103,11 +108,14 @@ thread_monitor(void *p) {
 		for (i=0;i<n;i++) {
 			skynet_monitor_check(m->m[i]);
 		}
+		skynet_handle_offline();
 		for (i=0;i<5;i++) {
 			CHECK_ABORT
 			sleep(1);
 		}
+		skynet_handle_online();
 	}
+	skynet_handle_offline();
 
 	return NULL;
 }
@@ -130,26 +138,28 @@ signal_hup() {
 static void *
 thread_timer(void *p) {
 	struct monitor * m = p;
+	bind_cpu("timer", m->timer_cpu);
 	skynet_initthread(THREAD_TIMER);
 	skynet_handle_register_thread();
 	for (;;) {
 		skynet_updatetime();
 		skynet_socket_updatetime();
 		CHECK_ABORT
-		wakeup(m,m->count-1);
-		usleep(2500);
+		skynet_handle_offline();
+		skynet_handle_reclaim();
+		skynet_timer_sleep();
+		skynet_handle_online();
 		if (SIG) {
 			signal_hup();
 			SIG = 0;
 		}
 	}
+	skynet_handle_offline();
 	// wakeup socket thread
 	skynet_socket_exit();
 	// wakeup all worker thread
-	pthread_mutex_lock(&m->mutex);
 	m->quit = 1;
-	pthread_cond_broadcast(&m->cond);
-	pthread_mutex_unlock(&m->mutex);
+	skynet_globalmq_exit();
 	return NULL;
 }
 
@@ -159,6 +169,20 @@ thread_worker(void *p) {
 	int id = wp->id;
 	int weight = wp->weight;
 	struct monitor *m = wp->m;
+	bind_cpu("worker", wp->cpu);
+	if (m->numa) {
+		// allocate the worker's structures (the monitor and the run queue) in their own pages after binding,
+		// so the memory is on the local node (first touch).
+		m->m[id] = skynet_monitor_new_local();
+	}
+	skynet_mq_register_worker(id);
+	if (m->numa) {
+		ATOM_FINC(&m->ready);
+		// wait for the run queues of the peers before stealing from them
+		while (ATOM_LOAD(&m->ready) < m->count) {
+			usleep(1000);
+		}
+	}
 	struct skynet_monitor *sm = m->m[id];
 	skynet_initthread(THREAD_WORKER);
 	skynet_handle_register_thread();
@@ -166,49 +190,76 @@ thread_worker(void *p) {
 	while (!m->quit) {
 		q = skynet_context_message_dispatch(sm, q, weight);
 		if (q == NULL) {
-			if (pthread_mutex_lock(&m->mutex) == 0) {
-				++ m->sleep;
-				// "spurious wakeup" is harmless,
-				// because skynet_context_message_dispatch() can be call at any time.
-				if (!m->quit)
-					pthread_cond_wait(&m->cond, &m->mutex);
-				-- m->sleep;
-				if (pthread_mutex_unlock(&m->mutex)) {
-					fprintf(stderr, "unlock mutex error");
-					exit(1);
-				}
-			}
+			// "spurious wakeup" is harmless,
+			// because skynet_context_message_dispatch() can be call at any time.
+			skynet_handle_offline();
+			skynet_globalmq_wait();
+			skynet_handle_online();
+		} else {
+			skynet_handle_quiescent();
 		}
 	}
+	skynet_handle_offline();
 	return NULL;
 }
 
+// Returns the cpu list for worker threads, or 0 if workers don't bind cpu.
+static int
+worker_cpus(struct skynet_config * config, int *cpus, int max) {
+	if (config->worker_cpu) {
+		int n = skynet_affinity_parse(config->worker_cpu, cpus, max);
+		if (n < 0) {
+			fprintf(stderr, "Invalid worker_cpu %s , should be a cpu list in [0,%d) like 0-3,8\n", config->worker_cpu, max);
+			exit(1);
+		}
+		return n;
+	}
+	if (config->socket_cpu < 0 && config->timer_cpu < 0) {
+		return 0;
+	}
+	// isolate the socket/timer thread, workers use the rest cpus
+	int i, n = 0;
+	for (i=0;i<max;i++) {
+		if (i != config->socket_cpu && i != config->timer_cpu) {
+			cpus[n++] = i;
+		}
+	}
+	return n;
+}
+
 static void
-start(int thread) {
-	pthread_t pid[thread+3];
+start(struct skynet_config * config) {
+	int thread = config->thread;
+	int socket_thread = config->socket_thread;
+	pthread_t pid[thread+socket_thread+2];
 
 	struct monitor *m = skynet_malloc(sizeof(*m));
 	memset(m, 0, sizeof(*m));
 	m->count = thread;
-	m->sleep = 0;
+	m->socket_cpu = config->socket_cpu;
+	m->timer_cpu = config->timer_cpu;
+	m->numa = config->numa;
+	ATOM_INIT(&m->ready, 0);
 
 	m->m = skynet_malloc(thread * sizeof(struct skynet_monitor *));
 	int i;
 	for (i=0;i<thread;i++) {
-		m->m[i] = skynet_monitor_new();
-	}
-	if (pthread_mutex_init(&m->mutex, NULL)) {
-		fprintf(stderr, "Init mutex error");
-		exit(1);
-	}
-	if (pthread_cond_init(&m->cond, NULL)) {
-		fprintf(stderr, "Init cond error");
-		exit(1);
+		m->m[i] = m->numa ? NULL : skynet_monitor_new();
 	}
 
-	create_thread(&pid[0], thread_monitor, m);
+	int ncpu = skynet_affinity_cpucount();
+	int cpus[ncpu];
+	int cpu_n = worker_cpus(config, cpus, ncpu);
+
 	create_thread(&pid[1], thread_timer, m);
-	create_thread(&pid[2], thread_socket, m);
+	struct worker_parm sp[socket_thread];
+	for (i=0;i<socket_thread;i++) {
+		sp[i].m = m;
+		sp[i].id = i;
+		sp[i].weight = 0;
+		sp[i].cpu = -1;
+		create_thread(&pid[i+2], thread_socket, &sp[i]);
+	}
 
 	static int weight[] = {
 		-1, -1, -1, -1, 0, 0, 0, 0,
@@ -224,10 +275,19 @@ start(int thread) {
 		} else {
 			wp[i].weight = 0;
 		}
-		create_thread(&pid[i+3], thread_worker, &wp[i]);
+		wp[i].cpu = cpu_n > 0 ? cpus[i % cpu_n] : -1;
+		create_thread(&pid[i+socket_thread+2], thread_worker, &wp[i]);
+	}
+
+	if (m->numa) {
+		// wait for the workers allocating their monitors
+		while (ATOM_LOAD(&m->ready) < thread) {
+			usleep(1000);
+		}
 	}
+	create_thread(&pid[0], thread_monitor, m);
 
-	for (i=0;i<thread+3;i++) {
+	for (i=0;i<thread+socket_thread+2;i++) {
 		pthread_join(pid[i], NULL);
 	}
 
@@ -276,13 +336,19 @@ skynet_start(struct skynet_config * config) {
 			exit(1);
 		}
 	}
+	if (config->numa && config->worker_cpu == NULL && config->socket_cpu < 0 && config->timer_cpu < 0) {
+		// the workers are not bound (see worker_cpus), so the node of a worker is unknown when it allocates
+		fprintf(stderr, "error: numa needs worker_cpu (or socket_cpu/timer_cpu) to bind the workers, numa is off\n");
+		config->numa = 0;
+	}
 	skynet_harbor_init(config->harbor);
-	skynet_handle_init(config->harbor, config->thread);
-	skynet_mq_init();
+	skynet_handle_init(config->harbor, config->thread + config->socket_thread);
+	skynet_mq_init(config->thread, config->worksteal, config->numa);
 	skynet_module_init(config->module_path);
-	skynet_timer_init();
-	skynet_socket_init();
+	skynet_timer_init(config->timer_resolution, config->timer_idle);
+	skynet_socket_init(config->socket_thread);
 	skynet_profile_enable(config->profile);
+	skynet_dispatch_budget(config->dispatch_budget);
 
 	const uint32_t logger_handle = skynet_context_new(config->logservice, config->logger);
 	if (logger_handle == 0) {
@@ -294,7 +360,7 @@ skynet_start(struct skynet_config * config) {
 
 	bootstrap(logger_handle, config->bootstrap);
 
-	start(config->thread);
+	start(config);
 
 	// harbor_exit may call socket send, so it should exit before socket_free
 	skynet_harbor_exit();
@@ -4,6 +4,7 @@
 #include "skynet_mq.h"
 #include "skynet_server.h"
 #include "skynet_handle.h"
+#include "atomic.h"
 #include "spinlock.h"
 
 #include <time.h>
@@ -11,57 +12,249 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <errno.h>
+#define TIMER_IDLE_SUPPORT
+#endif
 
 typedef void (*timer_execute_func)(void *ud,void *arg);
 
+// The near wheel is 2.56s for the centisecond ticks, and 1.024s for the millisecond ticks (see timer_resolution).
 #define TIME_NEAR_SHIFT 8
-#define TIME_NEAR (1 << TIME_NEAR_SHIFT)
+#define TIME_NEAR_SHIFT_MS 10
+#define TIME_NEAR_MAX (1 << TIME_NEAR_SHIFT_MS)
 #define TIME_LEVEL_SHIFT 6
 #define TIME_LEVEL (1 << TIME_LEVEL_SHIFT)
-#define TIME_NEAR_MASK (TIME_NEAR-1)
 #define TIME_LEVEL_MASK (TIME_LEVEL-1)
 
+// The threads add the timer nodes to their own staging lists without lock,
+// and the timer thread moves them into the wheel each tick, so only the timer thread touches the wheel.
+// Each node is stamped with the order of timer_add, and the wheel keeps the timers of the same expire time in that order,
+// even if they are added from different threads or merged in different ticks.
+#define TIMER_STAGING 64
+#define TIMER_CACHE_LINE 64
+
+// The session index is divided into stripes with their own locks, see struct timer_index.
+#define TIMER_INDEX_STRIPE 64
+#define TIMER_INDEX_SIZE 64
+
+// In timer_idle mode, the timer thread sleeps until the next timer (no more than TIMER_IDLE_MAX ms),
+// instead of waking up every quarter tick.
+#define TIMER_IDLE_MAX 1000
+
+// The free timer nodes move between the threads in batches of TIMER_POOL_BATCH,
+// and the pool keeps no more than TIMER_POOL_MAX batches.
+#define TIMER_POOL_BATCH 64
+#define TIMER_POOL_MAX 1024
+
 struct timer_event {
 	uint32_t handle;
 	int session;
 };
 
+// the state of the timer node, for the cancel request (timer thread only)
+#define TIMER_STAGED 0
+#define TIMER_LINKED 1
+#define TIMER_FIRED 2
+
 struct timer_node {
 	struct timer_node *next;
+	struct timer_node *prev;	// or the timer to free, for the cancel request
+	struct timer_node *index_next;	// in the session index
 	uint32_t expire;
+	uint32_t seq;	// the order of timer_add
+	int cancel;	// it's a cancel request in the staging list
+	int state;
 };
 
+#define TIMER_NODE_SIZE (sizeof(struct timer_node) + sizeof(struct timer_event))
+
+// The producers allocate nodes from their thread local caches, and only the timer thread frees them.
+struct timer_pool {
+	struct spinlock lock;
+	struct timer_node *batch;	// the full batches of free nodes, linked by index_next of the first node
+	size_t batches;
+	size_t nodes;	// all the nodes allocated
+	size_t reuse;	// the batches reused
+	size_t release;	// the batches released, when the pool is full
+	struct timer_node *local;	// the free nodes of the timer thread, less than a batch
+	int local_n;
+};
+
+// circular, head.next is the first and head.prev is the last
 struct link_list {
 	struct timer_node head;
-	struct timer_node *tail;
+};
+
+// (handle, session) -> timer_node , for skynet_timeout_cancel
+// The threads insert the timers (timer_add) and remove the canceled ones, and the timer thread removes the fired ones.
+// The one removes the timer from the index decides whether it fires.
+struct timer_index {
+	struct spinlock lock;
+	int size;
+	int count;
+	struct timer_node **slot;
+	char _pad[TIMER_CACHE_LINE - sizeof(struct spinlock) - sizeof(int) * 2 - sizeof(void *)];
+};
+
+struct timer_staging {
+	ATOM_POINTER head;	// struct timer_node * , in reverse order
+	char _pad[TIMER_CACHE_LINE - sizeof(ATOM_POINTER)];
 };
 
 struct timer {
-	struct link_list near[TIME_NEAR];
+	struct timer_staging staging[TIMER_STAGING];
+	ATOM_INT seq;	// the next order of timer_add
+	char _pad[TIMER_CACHE_LINE - sizeof(ATOM_INT)];
+	ATOM_INT staging_count;
+	ATOM_ULONG tick;	// the copy of time for the staging threads
+	struct link_list near[TIME_NEAR_MAX];
 	struct link_list t[4][TIME_LEVEL];
-	struct spinlock lock;
+	int near_shift;
+	uint32_t near_mask;
+	int resolution;	// ms per tick, 10 (centisecond) by default
+	int cs_ticks;	// ticks per centisecond
+	struct timer_index index[TIMER_INDEX_STRIPE];
+	struct timer_node *cancel;	// the cancel requests of the timers not merged yet, retry next tick
+	struct timer_node *defer;	// the timers added after the last merge began, merge next time
+	struct timer_pool pool;
 	uint32_t time;
 	uint32_t starttime;
-	uint64_t current;
-	uint64_t current_point;
+	uint64_t current;	// in centisecond
+	uint64_t current_base;
+	uint64_t ticks;
+	uint64_t current_point;	// in ticks
+	uint64_t start_point;	// in ticks, time is current_point - start_point
+	int idle;	// timer_idle mode
+	int timerfd;
+	int eventfd;	// to wake up the timer thread for an earlier timer
+	ATOM_INT sleeping;
+	ATOM_ULONG deadline;	// the tick to wake up, when sleeping
 };
 
 static struct timer * TI = NULL;
 
+static _Thread_local struct timer_staging * TLS_STAGING = NULL;
+static _Thread_local struct timer_node * TLS_FREE = NULL;	// the node cache of the producer thread
+
+static inline void
+link_init(struct link_list *list) {
+	list->head.next = list->head.prev = &list->head;
+}
+
+static inline int
+link_empty(struct link_list *list) {
+	return list->head.next == &list->head;
+}
+
+// returns the nodes as a NULL terminated list
 static inline struct timer_node *
 link_clear(struct link_list *list) {
-	struct timer_node * ret = list->head.next;
-	list->head.next = 0;
-	list->tail = &(list->head);
+	struct timer_node * ret = NULL;
+	if (!link_empty(list)) {
+		ret = list->head.next;
+		list->head.prev->next = NULL;
+	}
+	link_init(list);
 
 	return ret;
 }
 
+// insert the node after the ones added before it, it's usually the tail
+static inline void
+link_insert(struct link_list *list,struct timer_node *node) {
+	struct timer_node * prev = list->head.prev;
+	while (prev != &list->head && (int32_t)(prev->seq - node->seq) > 0) {
+		prev = prev->prev;
+	}
+	node->prev = prev;
+	node->next = prev->next;
+	prev->next->prev = node;
+	prev->next = node;
+}
+
 static inline void
-link(struct link_list *list,struct timer_node *node) {
-	list->tail->next = node;
-	list->tail = node;
-	node->next=0;
+unlink_node(struct timer_node *node) {
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+}
+
+static inline struct timer_event *
+node_event(struct timer_node *node) {
+	return (struct timer_event *)(node+1);
+}
+
+static inline uint32_t
+index_hash(uint32_t handle, int session) {
+	return (handle * 2654435761u) ^ (uint32_t)session;
+}
+
+static inline struct timer_index *
+index_stripe(struct timer *T, uint32_t handle, int session) {
+	return &T->index[index_hash(handle, session) % TIMER_INDEX_STRIPE];
+}
+
+static inline struct timer_node **
+index_slot(struct timer_node **slot, int size, uint32_t handle, int session) {
+	return &slot[(index_hash(handle, session) / TIMER_INDEX_STRIPE) & (size-1)];
+}
+
+static void
+index_insert(struct timer *T, struct timer_node *node) {
+	struct timer_event * e = node_event(node);
+	struct timer_index *idx = index_stripe(T, e->handle, e->session);
+	SPIN_LOCK(idx)
+	if (idx->count >= idx->size) {
+		int size = idx->size * 2;
+		struct timer_node ** slot = skynet_malloc(size * sizeof(*slot));
+		memset(slot, 0, size * sizeof(*slot));
+		int i;
+		for (i=0;i<idx->size;i++) {
+			struct timer_node * n = idx->slot[i];
+			while (n) {
+				struct timer_node * next = n->index_next;
+				struct timer_event * ne = node_event(n);
+				struct timer_node ** head = index_slot(slot, size, ne->handle, ne->session);
+				n->index_next = *head;
+				*head = n;
+				n = next;
+			}
+		}
+		skynet_free(idx->slot);
+		idx->slot = slot;
+		idx->size = size;
+	}
+	struct timer_node ** head = index_slot(idx->slot, idx->size, e->handle, e->session);
+	node->index_next = *head;
+	*head = node;
+	++idx->count;
+	SPIN_UNLOCK(idx)
+}
+
+// remove and return the node of (handle, session), or remove the node given (returns NULL if it's removed already)
+static struct timer_node *
+index_remove(struct timer *T, uint32_t handle, int session, struct timer_node *node) {
+	struct timer_index *idx = index_stripe(T, handle, session);
+	SPIN_LOCK(idx)
+	struct timer_node ** p = index_slot(idx->slot, idx->size, handle, session);
+	struct timer_node * n;
+	while ((n = *p)) {
+		struct timer_event * e = node_event(n);
+		if (node ? n == node : (e->handle == handle && e->session == session)) {
+			*p = n->index_next;
+			--idx->count;
+			break;
+		}
+		p = &n->index_next;
+	}
+	SPIN_UNLOCK(idx)
+	return n;
 }
 
 static void
@@ -69,11 +262,11 @@ add_node(struct timer *T,struct timer_node *node) {
 	uint32_t time=node->expire;
 	uint32_t current_time=T->time;
 	
-	if ((time|TIME_NEAR_MASK)==(current_time|TIME_NEAR_MASK)) {
-		link(&T->near[time&TIME_NEAR_MASK],node);
+	if ((time|T->near_mask)==(current_time|T->near_mask)) {
+		link_insert(&T->near[time&T->near_mask],node);
 	} else {
 		int i;
-		uint32_t mask=TIME_NEAR << TIME_LEVEL_SHIFT;
+		uint32_t mask=(T->near_mask + 1) << TIME_LEVEL_SHIFT;
 		for (i=0;i<3;i++) {
 			if ((time|(mask-1))==(current_time|(mask-1))) {
 				break;
@@ -81,21 +274,271 @@ add_node(struct timer *T,struct timer_node *node) {
 			mask <<= TIME_LEVEL_SHIFT;
 		}
 
-		link(&T->t[i][((time>>(TIME_NEAR_SHIFT + i*TIME_LEVEL_SHIFT)) & TIME_LEVEL_MASK)],node);	
+		link_insert(&T->t[i][((time>>(T->near_shift + i*TIME_LEVEL_SHIFT)) & TIME_LEVEL_MASK)],node);	
+	}
+}
+
+// take a batch from the pool, or allocate a new one
+static struct timer_node *
+pool_batch(struct timer_pool *p) {
+	struct timer_node * list = NULL;
+	SPIN_LOCK(p)
+	if (p->batch) {
+		list = p->batch;
+		p->batch = list->index_next;
+		--p->batches;
+		++p->reuse;
+	} else {
+		p->nodes += TIMER_POOL_BATCH;
+	}
+	SPIN_UNLOCK(p)
+	if (list)
+		return list;
+	int i;
+	for (i=0;i<TIMER_POOL_BATCH;i++) {
+		struct timer_node * node = skynet_malloc(TIMER_NODE_SIZE);
+		node->next = list;
+		list = node;
+	}
+	return list;
+}
+
+static inline struct timer_node *
+node_alloc(struct timer *T) {
+	struct timer_node * node = TLS_FREE;
+	if (node == NULL) {
+		node = pool_batch(&T->pool);
+	}
+	TLS_FREE = node->next;
+	return node;
+}
+
+// timer thread only
+static inline void
+node_free(struct timer *T, struct timer_node *node) {
+	struct timer_pool * p = &T->pool;
+	node->next = p->local;
+	p->local = node;
+	if (++p->local_n == TIMER_POOL_BATCH) {
+		int full = 0;
+		SPIN_LOCK(p)
+		if (p->batches < TIMER_POOL_MAX) {
+			node->index_next = p->batch;
+			p->batch = node;
+			++p->batches;
+		} else {
+			p->nodes -= TIMER_POOL_BATCH;
+			++p->release;
+			full = 1;
+		}
+		SPIN_UNLOCK(p)
+		if (full) {
+			while (node) {
+				struct timer_node * next = node->next;
+				skynet_free(node);
+				node = next;
+			}
+		}
+		p->local = NULL;
+		p->local_n = 0;
+	}
+}
+
+static void
+staging_push(struct timer *T, struct timer_node *node) {
+	struct timer_staging * s = TLS_STAGING;
+	if (s == NULL) {
+		// more threads than the staging lists share them, it's still safe (multiple producers)
+		int idx = ATOM_FINC(&T->staging_count);
+		s = TLS_STAGING = &T->staging[idx % TIMER_STAGING];
+	}
+	for (;;) {
+		uintptr_t head = ATOM_LOAD(&s->head);
+		node->next = (struct timer_node *)head;
+		if (ATOM_CAS_POINTER(&s->head, head, (uintptr_t)node))
+			break;
+	}
+}
+
+static uint64_t gettime();
+
+#ifdef TIMER_IDLE_SUPPORT
+
+// pair with the sleeping check in timer_idle_sleep, either the timer thread sees the node, or we see it's sleeping.
+static void
+timer_kick(struct timer *T, uint32_t expire) {
+	if (ATOM_LOAD(&T->sleeping) && (int32_t)(expire - (uint32_t)ATOM_LOAD(&T->deadline)) < 0) {
+		uint64_t one = 1;
+		if (write(T->eventfd, &one, sizeof(one)) < 0) {
+			// the counter is not zero, it's waking up already
+		}
 	}
 }
 
+#endif
+
 static void
-timer_add(struct timer *T,void *arg,size_t sz,int time) {
-	struct timer_node *node = (struct timer_node *)skynet_malloc(sizeof(*node)+sz);
-	memcpy(node+1,arg,sz);
+timer_add(struct timer *T,struct timer_event *event,int time) {
+	struct timer_node *node = node_alloc(T);
+	*node_event(node) = *event;
+	node->cancel = 0;
+	node->state = TIMER_STAGED;
+	node->seq = (uint32_t)ATOM_FINC(&T->seq);
+	if (T->idle) {
+		// the tick copy is stale while the timer thread sleeps, read the clock
+		node->expire = time + (uint32_t)(gettime() - T->start_point);
+	} else {
+		node->expire = time + (uint32_t)ATOM_LOAD(&T->tick);
+	}
+	// index it before staging, so it can be canceled once skynet_timeout returns
+	index_insert(T, node);
+	staging_push(T, node);
+#ifdef TIMER_IDLE_SUPPORT
+	if (T->idle) {
+		timer_kick(T, node->expire);
+	}
+#endif
+}
 
-	SPIN_LOCK(T);
+static inline void
+timer_response(struct timer_event *event) {
+	struct skynet_message message;
+	message.source = 0;
+	message.session = event->session;
+	message.data = NULL;
+	message.sz = (size_t)PTYPE_RESPONSE << MESSAGE_TYPE_SHIFT;
+
+	skynet_context_push(event->handle, &message);
+}
 
-		node->expire=time+T->time;
-		add_node(T,node);
+// free the canceled timer, returns the cancel request if the timer isn't merged yet
+static struct timer_node *
+timer_cancel(struct timer *T, struct timer_node *req) {
+	struct timer_node * node = req->prev;
+	switch (node->state) {
+	case TIMER_STAGED:
+		return req;
+	case TIMER_LINKED:
+		unlink_node(node);
+		break;
+	}
+	node_free(T, node);
+	node_free(T, req);
+	return NULL;
+}
+
+// merge two lists in the order of timer_add
+static struct timer_node *
+seq_merge(struct timer_node *a, struct timer_node *b) {
+	struct timer_node head;
+	struct timer_node * tail = &head;
+	while (a && b) {
+		if ((int32_t)(a->seq - b->seq) <= 0) {
+			tail->next = a;
+			a = a->next;
+		} else {
+			tail->next = b;
+			b = b->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = a ? a : b;
+	return head.next;
+}
 
-	SPIN_UNLOCK(T);
+// move the staging nodes into the wheel, and then cancel the timers (timer thread)
+static void
+timer_merge(struct timer *T) {
+	struct timer_node * cancel = NULL;
+	struct timer_node * run[TIMER_STAGING + 1];
+	int runs = 0;
+	// A timer added before the merge begins may be staged after its list is taken, so it comes next time.
+	// The timers added after the merge begins wait too, so the later ones of the same service can't fire before it.
+	uint32_t limit = (uint32_t)ATOM_LOAD(&T->seq);
+	if (T->defer) {
+		run[runs++] = T->defer;
+		T->defer = NULL;
+	}
+	int n = ATOM_LOAD(&T->staging_count);
+	if (n > TIMER_STAGING) {
+		n = TIMER_STAGING;
+	}
+	int i;
+	for (i=0;i<n;i++) {
+		struct timer_staging * s = &T->staging[i];
+		uintptr_t head;
+		do {
+			head = ATOM_LOAD(&s->head);
+		} while (head && !ATOM_CAS_POINTER(&s->head, head, (uintptr_t)NULL));
+		struct timer_node * node = (struct timer_node *)head;
+		// reverse it to the order of timer_add, and take the cancel requests out
+		struct timer_node * list = NULL;
+		while (node) {
+			struct timer_node * next = node->next;
+			if (node->cancel) {
+				node->next = cancel;
+				cancel = node;
+			} else {
+				node->next = list;
+				list = node;
+			}
+			node = next;
+		}
+		if (list) {
+			run[runs++] = list;
+		}
+	}
+	// merge the lists of the threads, so add_node appends them at the tails mostly
+	while (runs > 1) {
+		int j = 0;
+		for (i=0;i+1<runs;i+=2) {
+			run[j++] = seq_merge(run[i], run[i+1]);
+		}
+		if (runs & 1) {
+			run[j++] = run[runs-1];
+		}
+		runs = j;
+	}
+	struct timer_node * list = runs ? run[0] : NULL;
+	struct timer_node ** defer = &T->defer;
+	while (list) {
+		struct timer_node * next = list->next;
+		if ((int32_t)(list->seq - limit) >= 0) {
+			list->next = NULL;
+			*defer = list;
+			defer = &list->next;
+			list = next;
+			continue;
+		}
+		if ((int32_t)(list->expire - T->time) < 0) {
+			// the thread read the tick before the last shift
+			list->expire = T->time;
+		}
+		add_node(T, list);
+		list->state = TIMER_LINKED;
+		list = next;
+	}
+	// The service may add the timer and cancel it on different threads, so the timer may come next tick.
+	struct timer_node * retry = T->cancel;
+	T->cancel = NULL;
+	while (retry) {
+		struct timer_node * next = retry->next;
+		struct timer_node * miss = timer_cancel(T, retry);
+		if (miss) {
+			miss->next = T->cancel;
+			T->cancel = miss;
+		}
+		retry = next;
+	}
+	while (cancel) {
+		struct timer_node * next = cancel->next;
+		struct timer_node * miss = timer_cancel(T, cancel);
+		if (miss) {
+			miss->next = T->cancel;
+			T->cancel = miss;
+		}
+		cancel = next;
+	}
 }
 
 static void
@@ -110,12 +553,12 @@ move_list(struct timer *T, int level, int idx) {
 
 static void
 timer_shift(struct timer *T) {
-	int mask = TIME_NEAR;
+	uint32_t mask = T->near_mask + 1;
 	uint32_t ct = ++T->time;
 	if (ct == 0) {
 		move_list(T, 3, 0);
 	} else {
-		uint32_t time = ct >> TIME_NEAR_SHIFT;
+		uint32_t time = ct >> T->near_shift;
 		int i=0;
 
 		while ((ct & (mask-1))==0) {
@@ -132,77 +575,93 @@ timer_shift(struct timer *T) {
 }
 
 static inline void
-dispatch_list(struct timer_node *current) {
+dispatch_list(struct timer *T, struct timer_node *current) {
 	do {
-		struct timer_event * event = (struct timer_event *)(current+1);
-		struct skynet_message message;
-		message.source = 0;
-		message.session = event->session;
-		message.data = NULL;
-		message.sz = (size_t)PTYPE_RESPONSE << MESSAGE_TYPE_SHIFT;
-
-		skynet_context_push(event->handle, &message);
-		
+		struct timer_event * event = node_event(current);
 		struct timer_node * temp = current;
 		current=current->next;
-		skynet_free(temp);	
+		if (index_remove(T, event->handle, event->session, temp)) {
+			timer_response(event);
+			node_free(T, temp);
+		} else {
+			// canceled, the cancel request frees it
+			temp->state = TIMER_FIRED;
+		}
 	} while (current);
 }
 
 static inline void
 timer_execute(struct timer *T) {
-	int idx = T->time & TIME_NEAR_MASK;
+	int idx = T->time & T->near_mask;
 	
-	while (T->near[idx].head.next) {
+	while (!link_empty(&T->near[idx])) {
 		struct timer_node *current = link_clear(&T->near[idx]);
-		SPIN_UNLOCK(T);
-		// dispatch_list don't need lock T
-		dispatch_list(current);
-		SPIN_LOCK(T);
+		dispatch_list(T, current);
 	}
 }
 
 static void 
 timer_update(struct timer *T) {
-	SPIN_LOCK(T);
+	timer_merge(T);
 
 	// try to dispatch timeout 0 (rare condition)
 	timer_execute(T);
 
 	// shift time first, and then dispatch timer message
 	timer_shift(T);
+	ATOM_STORE(&T->tick, T->time);
 
 	timer_execute(T);
-
-	SPIN_UNLOCK(T);
 }
 
 static struct timer *
-timer_create_timer() {
+timer_create_timer(int resolution) {
 	struct timer *r=(struct timer *)skynet_malloc(sizeof(struct timer));
 	memset(r,0,sizeof(*r));
 
+	r->resolution = resolution;
+	r->cs_ticks = 10 / resolution;
+	r->near_shift = resolution < 10 ? TIME_NEAR_SHIFT_MS : TIME_NEAR_SHIFT;
+	r->near_mask = (1 << r->near_shift) - 1;
+
 	int i,j;
 
-	for (i=0;i<TIME_NEAR;i++) {
-		link_clear(&r->near[i]);
+	for (i=0;i<TIME_NEAR_MAX;i++) {
+		link_init(&r->near[i]);
 	}
 
 	for (i=0;i<4;i++) {
 		for (j=0;j<TIME_LEVEL;j++) {
-			link_clear(&r->t[i][j]);
+			link_init(&r->t[i][j]);
 		}
 	}
 
-	SPIN_INIT(r)
+	for (i=0;i<TIMER_STAGING;i++) {
+		ATOM_INIT(&r->staging[i].head, (uintptr_t)NULL);
+	}
+	ATOM_INIT(&r->staging_count, 0);
+	ATOM_INIT(&r->seq, 0);
+	ATOM_INIT(&r->tick, 0);
+
+	for (i=0;i<TIMER_INDEX_STRIPE;i++) {
+		struct timer_index * idx = &r->index[i];
+		SPIN_INIT(idx)
+		idx->size = TIMER_INDEX_SIZE;
+		idx->count = 0;
+		idx->slot = skynet_malloc(TIMER_INDEX_SIZE * sizeof(struct timer_node *));
+		memset(idx->slot, 0, TIMER_INDEX_SIZE * sizeof(struct timer_node *));
+	}
+	r->cancel = NULL;
+	r->defer = NULL;
+	SPIN_INIT(&r->pool)
 
 	r->current = 0;
 
 	return r;
 }
 
-int
-skynet_timeout(uint32_t handle, int time, int session) {
+static int
+timeout_ticks(uint32_t handle, int64_t time, int session) {
 	if (time <= 0) {
 		struct skynet_message message;
 		message.source = 0;
@@ -217,12 +676,58 @@ skynet_timeout(uint32_t handle, int time, int session) {
 		struct timer_event event;
 		event.handle = handle;
 		event.session = session;
-		timer_add(TI, &event, sizeof(event), time);
+		if (time > INT32_MAX) {
+			time = INT32_MAX;
+		}
+		timer_add(TI, &event, (int)time);
 	}
 
 	return session;
 }
 
+int
+skynet_timeout(uint32_t handle, int time, int session) {
+	return timeout_ticks(handle, (int64_t)time * TI->cs_ticks, session);
+}
+
+int
+skynet_timeout_ms(uint32_t handle, int ms, int session) {
+	int res = TI->resolution;
+	return timeout_ticks(handle, ((int64_t)ms + res - 1) / res, session);
+}
+
+int
+skynet_timeout_cancel(uint32_t handle, int session) {
+	struct timer_node * node = index_remove(TI, handle, session, NULL);
+	if (node == NULL) {
+		// it has fired
+		return 0;
+	}
+	// the timer thread unlinks and frees it
+	struct timer_node *req = node_alloc(TI);
+	req->cancel = 1;
+	req->prev = node;
+	staging_push(TI, req);
+	return 1;
+}
+
+void
+skynet_timer_poolstat(struct timer_pool_stat *stat) {
+	struct timer_pool * p = &TI->pool;
+	SPIN_LOCK(p)
+	stat->node = p->nodes;
+	stat->free = p->batches * TIMER_POOL_BATCH;
+	stat->reuse = p->reuse;
+	stat->release = p->release;
+	SPIN_UNLOCK(p)
+	stat->bytes = stat->node * TIMER_NODE_SIZE;
+}
+
+int
+skynet_timer_resolution(void) {
+	return TI->resolution;
+}
+
 // centisecond: 1/100 second
 static void
 systime(uint32_t *sec, uint32_t *cs) {
@@ -232,13 +737,14 @@ systime(uint32_t *sec, uint32_t *cs) {
 	*cs = (uint32_t)(ti.tv_nsec / 10000000);
 }
 
+// in ticks
 static uint64_t
 gettime() {
 	uint64_t t;
 	struct timespec ti;
 	clock_gettime(CLOCK_MONOTONIC, &ti);
-	t = (uint64_t)ti.tv_sec * 100;
-	t += ti.tv_nsec / 10000000;
+	t = (uint64_t)ti.tv_sec * (1000 / TI->resolution);
+	t += ti.tv_nsec / (TI->resolution * 1000000);
 	return t;
 }
 
@@ -251,7 +757,8 @@ skynet_updatetime(void) {
 	} else if (cp != TI->current_point) {
 		uint32_t diff = (uint32_t)(cp - TI->current_point);
 		TI->current_point = cp;
-		TI->current += diff;
+		TI->ticks += diff;
+		TI->current = TI->current_base + TI->ticks / TI->cs_ticks;
 		int i;
 		for (i=0;i<diff;i++) {
 			timer_update(TI);
@@ -266,16 +773,149 @@ skynet_starttime(void) {
 
 uint64_t 
 skynet_now(void) {
+	if (TI->idle) {
+		// TI->current is stale while the timer thread sleeps
+		return TI->current_base + (gettime() - TI->start_point) / TI->cs_ticks;
+	}
 	return TI->current;
 }
 
+#ifdef TIMER_IDLE_SUPPORT
+
+static int
+staging_pending(struct timer *T) {
+	int n = ATOM_LOAD(&T->staging_count);
+	if (n > TIMER_STAGING) {
+		n = TIMER_STAGING;
+	}
+	int i;
+	for (i=0;i<n;i++) {
+		if (ATOM_LOAD(&T->staging[i].head))
+			return 1;
+	}
+	return T->defer != NULL;
+}
+
+static inline uint32_t
+tick_min(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b) < 0 ? a : b;
+}
+
+// The next tick which has timers in the near wheel, or moves the timers in the levels into it.
+static uint32_t
+next_deadline(struct timer *T) {
+	uint32_t time = T->time;
+	uint32_t limit = time + TIMER_IDLE_MAX / T->resolution;
+	if (!link_empty(&T->near[time & T->near_mask])) {
+		// merged just now
+		return time + 1;
+	}
+	uint32_t end = time | T->near_mask;
+	uint32_t t = time;
+	while (t != end) {
+		++t;
+		if (!link_empty(&T->near[t & T->near_mask])) {
+			return tick_min(t, limit);
+		}
+	}
+	return tick_min(end + 1, limit);
+}
+
+static void
+timer_idle_sleep(struct timer *T) {
+	uint32_t deadline;
+	for (;;) {
+		deadline = next_deadline(T);
+		ATOM_STORE(&T->deadline, deadline);
+		ATOM_STORE(&T->sleeping, 1);
+		if (!staging_pending(T))
+			break;
+		ATOM_STORE(&T->sleeping, 0);
+		timer_merge(T);
+	}
+	uint64_t tick = T->current_point + (uint32_t)(deadline - T->time);
+	int tps = 1000 / T->resolution;	// ticks per second
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = tick / tps;
+	its.it_value.tv_nsec = (tick % tps) * T->resolution * 1000000;
+	timerfd_settime(T->timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+
+	struct pollfd fds[2];
+	fds[0].fd = T->timerfd;
+	fds[0].events = POLLIN;
+	fds[1].fd = T->eventfd;
+	fds[1].events = POLLIN;
+	if (poll(fds, 2, -1) > 0) {
+		uint64_t v;
+		if (fds[0].revents & POLLIN) {
+			if (read(T->timerfd, &v, sizeof(v)) < 0) {
+				// EAGAIN
+			}
+		}
+		if (fds[1].revents & POLLIN) {
+			if (read(T->eventfd, &v, sizeof(v)) < 0) {
+				// EAGAIN
+			}
+		}
+	}
+	ATOM_STORE(&T->sleeping, 0);
+}
+
+static int
+timer_idle_init(struct timer *T) {
+	T->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	if (T->timerfd < 0) {
+		return 1;
+	}
+	T->eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (T->eventfd < 0) {
+		close(T->timerfd);
+		return 1;
+	}
+	return 0;
+}
+
+#endif
+
+void
+skynet_timer_sleep(void) {
+#ifdef TIMER_IDLE_SUPPORT
+	if (TI->idle) {
+		timer_idle_sleep(TI);
+		return;
+	}
+#endif
+	// 4 times per tick, 2.5ms for the centisecond ticks
+	usleep(TI->resolution * 250);
+}
+
 void 
-skynet_timer_init(void) {
-	TI = timer_create_timer();
+skynet_timer_init(int resolution, int idle) {
+	if (resolution <= 0 || 10 % resolution != 0) {
+		fprintf(stderr, "Invalid timer_resolution %d ms, use 10\n", resolution);
+		resolution = 10;
+	}
+	TI = timer_create_timer(resolution);
 	uint32_t current = 0;
 	systime(&TI->starttime, &current);
-	TI->current = current;
-	TI->current_point = gettime();
+	TI->current = TI->current_base = current;
+	TI->current_point = TI->start_point = gettime();
+
+	ATOM_INIT(&TI->sleeping, 0);
+	ATOM_INIT(&TI->deadline, 0);
+	TI->idle = 0;
+	if (idle) {
+#ifdef TIMER_IDLE_SUPPORT
+		if (timer_idle_init(TI) == 0) {
+			TI->idle = 1;
+		} else {
+			fprintf(stderr, "Can't create timerfd, timer_idle is off\n");
+		}
+#else
+		fprintf(stderr, "timer_idle is not supported on this platform\n");
+#endif
+	}
 }
 
 // for profile
@@ -290,3 +930,11 @@ skynet_thread_time(void) {
 
 	return (uint64_t)ti.tv_sec * MICROSEC + (uint64_t)ti.tv_nsec / (NANOSEC / MICROSEC);
 }
+
+uint64_t
+skynet_clock_time(void) {
+	struct timespec ti;
+	clock_gettime(CLOCK_MONOTONIC, &ti);
+
+	return (uint64_t)ti.tv_sec * MICROSEC + (uint64_t)ti.tv_nsec / (NANOSEC / MICROSEC);
+}
@@ -2,12 +2,31 @@
 #define SKYNET_TIMER_H
 
 #include <stdint.h>
+#include <stddef.h>
 
-int skynet_timeout(uint32_t handle, int time, int session);
+struct timer_pool_stat {
+	size_t node;	// all the timer nodes allocated
+	size_t free;	// the free nodes in the pool, not including the thread caches
+	size_t reuse;	// the batches of nodes reused
+	size_t release;	// the batches of nodes freed, when the pool is full
+	size_t bytes;
+};
+
+// The timers of the same expire time fire in the order they are added, even from different threads.
+int skynet_timeout(uint32_t handle, int time, int session);	// time in centisecond
+int skynet_timeout_ms(uint32_t handle, int ms, int session);
+int skynet_timer_resolution(void);	// ms per tick
+// returns 1 if the timer of the session is removed (no response), or 0 if it has fired
+int skynet_timeout_cancel(uint32_t handle, int session);
+void skynet_timer_poolstat(struct timer_pool_stat *stat);
 void skynet_updatetime(void);
 uint32_t skynet_starttime(void);
 uint64_t skynet_thread_time(void);	// for profile, in micro second
+uint64_t skynet_clock_time(void);	// monotonic clock for latency stat, in micro second
+
+// sleep in the timer thread until the next update
+void skynet_timer_sleep(void);
 
-void skynet_timer_init(void);
+void skynet_timer_init(int resolution, int idle);
 
 #endif
@@ -14,4 +14,13 @@ struct socket_sendbuffer {
 	size_t sz;
 };
 
+// the pool of the tcp read buffers
+struct socket_pool_stat {
+	size_t buffer;	// all the buffers allocated by the pool
+	size_t free;	// the free buffers in the pool, not including the thread caches
+	size_t reuse;	// the batches of buffers reused
+	size_t release;	// the batches of buffers freed, when the pool is full
+	size_t bytes;
+};
+
 #endif
@@ -10,6 +10,14 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 
+#ifdef USE_EPOLL_ET
+// edge triggered, socket_server should read the socket until EAGAIN (or defer it, see sp_poll)
+#define SP_EDGE_TRIGGERED
+#define SP_EPOLL_MODE EPOLLET
+#else
+#define SP_EPOLL_MODE 0
+#endif
+
 static bool 
 sp_invalid(int efd) {
 	return efd == -1;
@@ -26,9 +34,9 @@ sp_release(int efd) {
 }
 
 static int 
-sp_add(int efd, int sock, void *ud) {
+sp_add(int efd, int sock, void *ud, bool read_enable) {
 	struct epoll_event ev;
-	ev.events = EPOLLIN;
+	ev.events = (read_enable ? EPOLLIN : 0) | SP_EPOLL_MODE;
 	ev.data.ptr = ud;
 	if (epoll_ctl(efd, EPOLL_CTL_ADD, sock, &ev) == -1) {
 		return 1;
@@ -44,7 +52,7 @@ sp_del(int efd, int sock) {
 static int
 sp_enable(int efd, int sock, void *ud, bool read_enable, bool write_enable) {
 	struct epoll_event ev;
-	ev.events = (read_enable ? EPOLLIN : 0) | (write_enable ? EPOLLOUT : 0);
+	ev.events = (read_enable ? EPOLLIN : 0) | (write_enable ? EPOLLOUT : 0) | SP_EPOLL_MODE;
 	ev.data.ptr = ud;
 	if (epoll_ctl(efd, EPOLL_CTL_MOD, sock, &ev) == -1) {
 		return 1;
@@ -52,10 +60,10 @@ sp_enable(int efd, int sock, void *ud, bool read_enable, bool write_enable) {
 	return 0;
 }
 
-static int 
-sp_wait(int efd, struct event *e, int max) {
+static int
+sp_wait_(int efd, struct event *e, int max, int timeout) {
 	struct epoll_event ev[max];
-	int n = epoll_wait(efd , ev, max, -1);
+	int n = epoll_wait(efd , ev, max, timeout);
 	int i;
 	for (i=0;i<n;i++) {
 		e[i].s = ev[i].data.ptr;
@@ -64,11 +72,25 @@ sp_wait(int efd, struct event *e, int max) {
 		e[i].read = (flag & EPOLLIN) != 0;
 		e[i].error = (flag & EPOLLERR) != 0;
 		e[i].eof = (flag & EPOLLHUP) != 0;
+		e[i].recv = false;
 	}
 
 	return n;
 }
 
+static int 
+sp_wait(int efd, struct event *e, int max) {
+	return sp_wait_(efd, e, max, -1);
+}
+
+#ifdef SP_EDGE_TRIGGERED
+// don't block, when there are sockets deferred
+static int
+sp_poll(int efd, struct event *e, int max) {
+	return sp_wait_(efd, e, max, 0);
+}
+#endif
+
 static void
 sp_nonblocking(int fd) {
 	int flag = fcntl(fd, F_GETFL, 0);
@@ -35,9 +35,9 @@ sp_del(int kfd, int sock) {
 }
 
 static int 
-sp_add(int kfd, int sock, void *ud) {
+sp_add(int kfd, int sock, void *ud, bool read_enable) {
 	struct kevent ke;
-	EV_SET(&ke, sock, EVFILT_READ, EV_ADD, 0, 0, ud);
+	EV_SET(&ke, sock, EVFILT_READ, read_enable ? EV_ADD : EV_ADD | EV_DISABLE, 0, 0, ud);
 	if (kevent(kfd, &ke, 1, NULL, 0, NULL) == -1 ||	ke.flags & EV_ERROR) {
 		return 1;
 	}
@@ -84,6 +84,7 @@ sp_wait(int kfd, struct event *e, int max) {
 		e[i].read = (filter == EVFILT_READ);
 		e[i].error = (ev[i].flags & EV_ERROR) != 0;
 		e[i].eof = eof;
+		e[i].recv = false;
 	}
 
 	return n;
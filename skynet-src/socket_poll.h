@@ -3,7 +3,12 @@
 
 #include <stdbool.h>
 
+#if defined(__linux__) && defined(USE_IO_URING)
+struct sp_uring;
+typedef struct sp_uring * poll_fd;
+#else
 typedef int poll_fd;
+#endif
 
 struct event {
 	void * s;
@@ -11,20 +16,27 @@ struct event {
 	bool write;
 	bool error;
 	bool eof;
+	bool recv;	// the data is received by the poller already (io_uring)
+	int size;	// size of the data in buffer, or -errno
+	char * buffer;
 };
 
 static bool sp_invalid(poll_fd fd);
 static poll_fd sp_create();
 static void sp_release(poll_fd fd);
-static int sp_add(poll_fd fd, int sock, void *ud);
+static int sp_add(poll_fd fd, int sock, void *ud, bool read_enable);
 static void sp_del(poll_fd fd, int sock);
 static int sp_enable(poll_fd, int sock, void *ud, bool read_enable, bool write_enable);
 static int sp_wait(poll_fd, struct event *e, int max);
 static void sp_nonblocking(int sock);
 
 #ifdef __linux__
+#ifdef USE_IO_URING
+#include "socket_uring.h"
+#else
 #include "socket_epoll.h"
 #endif
+#endif
 
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined (__NetBSD__)
 #include "socket_kqueue.h"
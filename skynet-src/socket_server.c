@@ -1,3 +1,4 @@
+#define _GNU_SOURCE	// for recvmmsg/sendmmsg
 #include "skynet.h"
 
 #include "socket_server.h"
@@ -8,6 +9,7 @@
 #include <sys/types.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/tcp.h>
 #include <unistd.h>
 #include <errno.h>
@@ -17,12 +19,29 @@
 #include <stdint.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
 
 #define MAX_INFO 128
 // MAX_SOCKET will be 2^MAX_SOCKET_P
 #define MAX_SOCKET_P 16
 #define MAX_EVENT 64
+// the reads (or accepts, or udp batches) of one socket in one event, the socket is deferred when it's used up
+#define MAX_READ_BUDGET 16
 #define MIN_READ_BUFFER 64
+// the write buffers flushed by one writev
+#ifdef IOV_MAX
+#define MAX_WRITEV IOV_MAX
+#else
+#define MAX_WRITEV 64
+#endif
+// The tcp read buffers are pooled in the size classes of power of 2, from MIN_READ_BUFFER to RECV_POOL_MAXSIZE.
+// The free buffers move between the threads in batches of RECV_POOL_BATCH_BYTES (no more than RECV_POOL_BATCH buffers),
+// and each class keeps no more than RECV_POOL_MAX_BYTES.
+#define RECV_POOL_CLASS 11
+#define RECV_POOL_MAXSIZE (MIN_READ_BUFFER << (RECV_POOL_CLASS - 1))
+#define RECV_POOL_BATCH 64
+#define RECV_POOL_BATCH_BYTES (64 * 1024)
+#define RECV_POOL_MAX_BYTES (1024 * 1024)
 #define SOCKET_TYPE_INVALID 0
 #define SOCKET_TYPE_RESERVE 1
 #define SOCKET_TYPE_PLISTEN 2
@@ -40,6 +59,7 @@
 #define PRIORITY_LOW 1
 
 #define HASH_ID(id) (((unsigned)id) % MAX_SOCKET)
+#define MAX_POLLER 64
 #define ID_TAG16(id) ((id>>MAX_SOCKET_P) & 0xffff)
 
 #define PROTOCOL_TCP 0
@@ -50,6 +70,8 @@
 #define UDP_ADDRESS_SIZE 19	// ipv6 128bit + port 16bit + 1 byte type
 
 #define MAX_UDP_PACKAGE 65535
+// the datagrams received (recvmmsg) or sent (sendmmsg) by one syscall
+#define MAX_UDP_BATCH 16
 
 // EAGAIN and EWOULDBLOCK may be not the same value.
 #if (EAGAIN != EWOULDBLOCK)
@@ -113,24 +135,73 @@ struct socket {
 	size_t dw_size;
 };
 
-struct socket_server {
-	volatile uint64_t time;
+union sockaddr_all {
+	struct sockaddr s;
+	struct sockaddr_in v4;
+	struct sockaddr_in6 v6;
+};
+
+// The datagrams received by one recvmmsg, forward_message_udp returns them one by one.
+struct udp_batch {
+	int id;	// the socket of the datagrams
+	int n;
+	int index;
+	uint8_t *buffer;	// MAX_UDP_BATCH * MAX_UDP_PACKAGE, only the pages used are touched
+	int size[MAX_UDP_BATCH];
+	socklen_t addrsz[MAX_UDP_BATCH];
+	union sockaddr_all addr[MAX_UDP_BATCH];
+};
+
+// Each poller thread owns the sockets of the slots HASH_ID(id) % poller_n, with its own event pool and ctrl pipe.
+struct socket_poller {
 	int reserve_fd;	// for EMFILE
 	int recvctrl_fd;
 	int sendctrl_fd;
 	int checkctrl;
 	poll_fd event_fd;
-	ATOM_INT alloc_id;
 	int event_n;
 	int event_index;
-	struct socket_object_interface soi;
 	struct event ev[MAX_EVENT];
-	struct socket slot[MAX_SOCKET];
+	int budget_index;	// the event index of the budget
+	int budget;
+	int pending_n;
+	int pending[MAX_EVENT];	// the socket ids deferred, in edge triggered mode
 	char buffer[MAX_INFO];
-	uint8_t udpbuffer[MAX_UDP_PACKAGE];
+	struct udp_batch udp;
 	fd_set rfds;
 };
 
+// a free buffer in the pool
+struct recv_buffer {
+	struct recv_buffer *next;
+	struct recv_buffer *batch_next;	// in the first buffer of a batch
+};
+
+struct recv_pool {
+	struct spinlock lock;
+	struct recv_buffer *batch;
+	int batches;
+	size_t buffer;	// all the buffers allocated
+	size_t reuse;	// the batches reused
+	size_t release;	// the batches released, when the pool is full
+};
+
+// the free buffers of the thread, less than a batch
+struct recv_cache {
+	struct recv_buffer *list;
+	int n;
+};
+
+struct socket_server {
+	volatile uint64_t time;
+	ATOM_INT alloc_id;
+	int poller_n;
+	struct socket_poller *poller;
+	struct recv_pool pool[RECV_POOL_CLASS];
+	struct socket_object_interface soi;
+	struct socket slot[MAX_SOCKET];
+};
+
 struct request_open {
 	int id;
 	int port;
@@ -236,12 +307,6 @@ struct request_package {
 	uint8_t dummy[256];
 };
 
-union sockaddr_all {
-	struct sockaddr s;
-	struct sockaddr_in v4;
-	struct sockaddr_in6 v6;
-};
-
 struct send_object {
 	const void * buffer;
 	size_t sz;
@@ -251,6 +316,8 @@ struct send_object {
 #define MALLOC skynet_malloc
 #define FREE skynet_free
 
+static _Thread_local struct recv_cache TLS_RECV[RECV_POOL_CLASS];
+
 struct socket_lock {
 	struct spinlock *lock;
 	int count;
@@ -289,6 +356,150 @@ socket_unlock(struct socket_lock *sl) {
 	}
 }
 
+static inline struct socket_poller *
+socket_poller(struct socket_server *ss, int id) {
+	return &ss->poller[HASH_ID(id) % ss->poller_n];
+}
+
+// the class of the buffer of sz bytes, RECV_POOL_CLASS for the large one (not pooled)
+static inline int
+recv_class(int sz) {
+	if (sz <= MIN_READ_BUFFER)
+		return 0;
+	if (sz > RECV_POOL_MAXSIZE)
+		return RECV_POOL_CLASS;
+	return 32 - __builtin_clz(sz - 1) - __builtin_ctz(MIN_READ_BUFFER);
+}
+
+static inline int
+recv_batch(int class) {
+	int n = RECV_POOL_BATCH_BYTES / (MIN_READ_BUFFER << class);
+	return n > RECV_POOL_BATCH ? RECV_POOL_BATCH : n;
+}
+
+static void
+recv_pool_init(struct socket_server *ss) {
+	int i;
+	for (i=0;i<RECV_POOL_CLASS;i++) {
+		struct recv_pool *p = &ss->pool[i];
+		memset(p, 0, sizeof(*p));
+		spinlock_init(&p->lock);
+	}
+}
+
+static void
+free_batch(struct recv_buffer *list) {
+	while (list) {
+		struct recv_buffer *next = list->next;
+		FREE(list);
+		list = next;
+	}
+}
+
+static void
+recv_pool_release(struct socket_server *ss) {
+	int i;
+	for (i=0;i<RECV_POOL_CLASS;i++) {
+		struct recv_pool *p = &ss->pool[i];
+		struct recv_buffer *batch = p->batch;
+		while (batch) {
+			struct recv_buffer *next = batch->batch_next;
+			free_batch(batch);
+			batch = next;
+		}
+		spinlock_destroy(&p->lock);
+	}
+}
+
+// The buffer size is rounded up to the class, so the buffer of sz bytes data can be given back by recv_free(sz).
+static void *
+recv_alloc(struct socket_server *ss, int sz) {
+	int class = recv_class(sz);
+	if (class >= RECV_POOL_CLASS)
+		return MALLOC(sz);
+	struct recv_cache *c = &TLS_RECV[class];
+	struct recv_buffer *b = c->list;
+	if (b == NULL) {
+		// take a batch from the pool
+		struct recv_pool *p = &ss->pool[class];
+		spinlock_lock(&p->lock);
+		b = p->batch;
+		if (b) {
+			p->batch = b->batch_next;
+			--p->batches;
+			++p->reuse;
+		} else {
+			++p->buffer;
+		}
+		spinlock_unlock(&p->lock);
+		if (b == NULL)
+			return MALLOC(MIN_READ_BUFFER << class);
+		c->n = recv_batch(class);
+	}
+	c->list = b->next;
+	--c->n;
+	return b;
+}
+
+static void
+recv_free(struct socket_server *ss, void *buffer, int sz) {
+	if (buffer == NULL)
+		return;
+	int class = recv_class(sz);
+	if (class >= RECV_POOL_CLASS) {
+		FREE(buffer);
+		return;
+	}
+	struct recv_cache *c = &TLS_RECV[class];
+	struct recv_buffer *b = buffer;
+	b->next = c->list;
+	c->list = b;
+	int n = recv_batch(class);
+	if (++c->n < n)
+		return;
+	// push the full batch into the pool
+	c->list = NULL;
+	c->n = 0;
+	struct recv_pool *p = &ss->pool[class];
+	int full = 0;
+	spinlock_lock(&p->lock);
+	if (p->batches < RECV_POOL_MAX_BYTES / (n * (MIN_READ_BUFFER << class))) {
+		b->batch_next = p->batch;
+		p->batch = b;
+		++p->batches;
+	} else {
+		p->buffer -= n;
+		++p->release;
+		full = 1;
+	}
+	spinlock_unlock(&p->lock);
+	if (full)
+		free_batch(b);
+}
+
+void
+socket_server_freebuffer(struct socket_server *ss, void *buffer, int sz) {
+	recv_free(ss, buffer, sz);
+}
+
+void
+socket_server_poolstat(struct socket_server *ss, struct socket_pool_stat *stat) {
+	memset(stat, 0, sizeof(*stat));
+	int i;
+	for (i=0;i<RECV_POOL_CLASS;i++) {
+		struct recv_pool *p = &ss->pool[i];
+		size_t size = MIN_READ_BUFFER << i;
+		size_t n = recv_batch(i);
+		spinlock_lock(&p->lock);
+		stat->buffer += p->buffer;
+		stat->free += p->batches * n;
+		stat->reuse += p->reuse;
+		stat->release += p->release;
+		stat->bytes += p->buffer * size;
+		spinlock_unlock(&p->lock);
+	}
+}
+
 static inline int
 socket_invalid(struct socket *s, int id) {
 	return (s->id != id || ATOM_LOAD(&s->type) == SOCKET_TYPE_INVALID);
@@ -387,36 +598,75 @@ clear_wb_list(struct wb_list *list) {
 	list->tail = NULL;
 }
 
-struct socket_server *
-socket_server_create(uint64_t time) {
-	int i;
+static int
+poller_init(struct socket_poller *p) {
 	int fd[2];
 	poll_fd efd = sp_create();
 	if (sp_invalid(efd)) {
 		skynet_error(NULL, "socket-server error: create event pool failed.");
-		return NULL;
+		return 1;
 	}
 	if (pipe(fd)) {
 		sp_release(efd);
 		skynet_error(NULL, "socket-server error: create socket pair failed.");
-		return NULL;
+		return 1;
 	}
-	if (sp_add(efd, fd[0], NULL)) {
+	if (sp_add(efd, fd[0], NULL, true)) {
 		// add recvctrl_fd to event poll
 		skynet_error(NULL, "socket-server error: can't add server fd to event pool.");
 		close(fd[0]);
 		close(fd[1]);
 		sp_release(efd);
+		return 1;
+	}
+	p->event_fd = efd;
+	p->recvctrl_fd = fd[0];
+	p->sendctrl_fd = fd[1];
+	p->checkctrl = 1;
+	p->reserve_fd = dup(1);	// reserve an extra fd for EMFILE
+	p->event_n = 0;
+	p->event_index = 0;
+	p->budget_index = -1;
+	p->budget = 0;
+	p->pending_n = 0;
+	memset(&p->udp, 0, sizeof(p->udp));
+	FD_ZERO(&p->rfds);
+	assert(p->recvctrl_fd < FD_SETSIZE);
+	return 0;
+}
+
+static void
+poller_release(struct socket_poller *p) {
+	close(p->sendctrl_fd);
+	close(p->recvctrl_fd);
+	sp_release(p->event_fd);
+	if (p->reserve_fd >= 0)
+		close(p->reserve_fd);
+	FREE(p->udp.buffer);
+}
+
+struct socket_server *
+socket_server_create(uint64_t time, int poller) {
+	int i;
+	if (poller < 1 || poller > MAX_POLLER) {
+		skynet_error(NULL, "socket-server error: invalid poller number %d.", poller);
 		return NULL;
 	}
+	struct socket_poller *p = MALLOC(poller * sizeof(*p));
+	for (i=0;i<poller;i++) {
+		if (poller_init(&p[i])) {
+			while (--i >= 0) {
+				poller_release(&p[i]);
+			}
+			FREE(p);
+			return NULL;
+		}
+	}
 
 	struct socket_server *ss = MALLOC(sizeof(*ss));
 	ss->time = time;
-	ss->event_fd = efd;
-	ss->recvctrl_fd = fd[0];
-	ss->sendctrl_fd = fd[1];
-	ss->checkctrl = 1;
-	ss->reserve_fd = dup(1);	// reserve an extra fd for EMFILE
+	ss->poller_n = poller;
+	ss->poller = p;
 
 	for (i=0;i<MAX_SOCKET;i++) {
 		struct socket *s = &ss->slot[i];
@@ -426,11 +676,8 @@ socket_server_create(uint64_t time) {
 		spinlock_init(&s->dw_lock);
 	}
 	ATOM_INIT(&ss->alloc_id , 0);
-	ss->event_n = 0;
-	ss->event_index = 0;
 	memset(&ss->soi, 0, sizeof(ss->soi));
-	FD_ZERO(&ss->rfds);
-	assert(ss->recvctrl_fd < FD_SETSIZE);
+	recv_pool_init(ss);
 
 	return ss;
 }
@@ -501,7 +748,7 @@ force_close(struct socket_server *ss, struct socket *s, struct socket_lock *l, s
 	assert(type != SOCKET_TYPE_RESERVE);
 	free_wb_list(ss,&s->high);
 	free_wb_list(ss,&s->low);
-	sp_del(ss->event_fd, s->fd);
+	sp_del(socket_poller(ss, s->id)->event_fd, s->fd);
 	socket_lock(l);
 	if (type != SOCKET_TYPE_BIND) {
 		if (close(s->fd) < 0) {
@@ -534,11 +781,11 @@ socket_server_release(struct socket_server *ss) {
 		}
 		spinlock_destroy(&s->dw_lock);
 	}
-	close(ss->sendctrl_fd);
-	close(ss->recvctrl_fd);
-	sp_release(ss->event_fd);
-	if (ss->reserve_fd >= 0)
-		close(ss->reserve_fd);
+	for (i=0;i<ss->poller_n;i++) {
+		poller_release(&ss->poller[i]);
+	}
+	FREE(ss->poller);
+	recv_pool_release(ss);
 	FREE(ss);
 }
 
@@ -552,7 +799,12 @@ static inline int
 enable_write(struct socket_server *ss, struct socket *s, bool enable) {
 	if (s->writing != enable) {
 		s->writing = enable;
-		return sp_enable(ss->event_fd, s->fd, s, s->reading, enable);
+#ifdef SP_EDGE_TRIGGERED
+		// Keep EPOLLOUT, it reports only the edges. The write events are ignored when s->writing is false.
+		if (!enable)
+			return 0;
+#endif
+		return sp_enable(socket_poller(ss, s->id)->event_fd, s->fd, s, s->reading, enable);
 	}
 	return 0;
 }
@@ -561,7 +813,7 @@ static inline int
 enable_read(struct socket_server *ss, struct socket *s, bool enable) {
 	if (s->reading != enable) {
 		s->reading = enable;
-		return sp_enable(ss->event_fd, s->fd, s, enable, s->writing);
+		return sp_enable(socket_poller(ss, s->id)->event_fd, s->fd, s, enable, s->writing);
 	}
 	return 0;
 }
@@ -571,14 +823,9 @@ new_fd(struct socket_server *ss, int id, int fd, int protocol, uintptr_t opaque,
 	struct socket * s = &ss->slot[HASH_ID(id)];
 	assert(ATOM_LOAD(&s->type) == SOCKET_TYPE_RESERVE);
 
-	if (sp_add(ss->event_fd, fd, s)) {
-		ATOM_STORE(&s->type, SOCKET_TYPE_INVALID);
-		return NULL;
-	}
-
 	s->id = id;
 	s->fd = fd;
-	s->reading = true;
+	s->reading = reading;
 	s->writing = false;
 	s->closing = false;
 	ATOM_INIT(&s->sending , ID_TAG16(id) << 16 | 0);
@@ -592,8 +839,10 @@ new_fd(struct socket_server *ss, int id, int fd, int protocol, uintptr_t opaque,
 	s->dw_buffer = NULL;
 	s->dw_size = 0;
 	memset(&s->stat, 0, sizeof(s->stat));
-	if (enable_read(ss, s, reading)) {
-		ATOM_STORE(&s->type , SOCKET_TYPE_INVALID);
+	// The accepted socket may belong to another poller, so it's added with the reading state at once,
+	// the other poller shouldn't see any event before it's started.
+	if (sp_add(socket_poller(ss, id)->event_fd, fd, s, reading)) {
+		ATOM_STORE(&s->type, SOCKET_TYPE_INVALID);
 		return NULL;
 	}
 	return s;
@@ -668,8 +917,9 @@ open_socket(struct socket_server *ss, struct request_open * request, struct sock
 		ATOM_STORE(&ns->type , SOCKET_TYPE_CONNECTED);
 		struct sockaddr * addr = ai_ptr->ai_addr;
 		void * sin_addr = (ai_ptr->ai_family == AF_INET) ? (void*)&((struct sockaddr_in *)addr)->sin_addr : (void*)&((struct sockaddr_in6 *)addr)->sin6_addr;
-		if (inet_ntop(ai_ptr->ai_family, sin_addr, ss->buffer, sizeof(ss->buffer))) {
-			result->data = ss->buffer;
+		char * buffer = socket_poller(ss, id)->buffer;
+		if (inet_ntop(ai_ptr->ai_family, sin_addr, buffer, MAX_INFO)) {
+			result->data = buffer;
 		}
 		freeaddrinfo( ai_list );
 		return SOCKET_OPEN;
@@ -724,34 +974,64 @@ close_write(struct socket_server *ss, struct socket *s, struct socket_lock *l, s
 	}
 }
 
+// Remove the buffers of sz bytes written from the list, returns the bytes left.
+static ssize_t
+list_written(struct socket_server *ss, struct wb_list *list, ssize_t sz) {
+	struct write_buffer * tmp;
+	while ((tmp = list->head)) {
+		if ((ssize_t)tmp->sz > sz) {
+			tmp->ptr += sz;
+			tmp->sz -= sz;
+			return 0;
+		}
+		sz -= tmp->sz;
+		list->head = tmp->next;
+		write_buffer_free(ss,tmp);
+	}
+	list->tail = NULL;
+	return sz;
+}
+
+// Gather the buffers of high list, and then low list (when all the high list is gathered), into one writev.
 static int
-send_list_tcp(struct socket_server *ss, struct socket *s, struct wb_list *list, struct socket_lock *l, struct socket_message *result) {
-	while (list->head) {
-		struct write_buffer * tmp = list->head;
-		for (;;) {
-			ssize_t sz = write(s->fd, tmp->ptr, tmp->sz);
-			if (sz < 0) {
-				switch(errno) {
-				case EINTR:
-					continue;
-				case AGAIN_WOULDBLOCK:
-					return -1;
-				}
-				return close_write(ss, s, l, result);
+send_list_tcp(struct socket_server *ss, struct socket *s, struct socket_lock *l, struct socket_message *result) {
+	struct iovec iov[MAX_WRITEV];
+	while (s->high.head || s->low.head) {
+		struct write_buffer * tmp;
+		int n = 0;
+		size_t total = 0;
+		for (tmp = s->high.head; tmp && n < MAX_WRITEV; tmp = tmp->next) {
+			iov[n].iov_base = tmp->ptr;
+			iov[n].iov_len = tmp->sz;
+			total += tmp->sz;
+			++n;
+		}
+		if (tmp == NULL) {
+			for (tmp = s->low.head; tmp && n < MAX_WRITEV; tmp = tmp->next) {
+				iov[n].iov_base = tmp->ptr;
+				iov[n].iov_len = tmp->sz;
+				total += tmp->sz;
+				++n;
 			}
-			stat_write(ss,s,(int)sz);
-			s->wb_size -= sz;
-			if (sz != tmp->sz) {
-				tmp->ptr += sz;
-				tmp->sz -= sz;
+		}
+		ssize_t sz = writev(s->fd, iov, n);
+		if (sz < 0) {
+			switch(errno) {
+			case EINTR:
+				continue;
+			case AGAIN_WOULDBLOCK:
 				return -1;
 			}
-			break;
+			return close_write(ss, s, l, result);
+		}
+		stat_write(ss,s,(int)sz);
+		s->wb_size -= sz;
+		// The low list may be written partly, see send_buffer_
+		list_written(ss, &s->low, list_written(ss, &s->high, sz));
+		if ((size_t)sz != total) {
+			return -1;
 		}
-		list->head = tmp->next;
-		write_buffer_free(ss,tmp);
 	}
-	list->tail = NULL;
 
 	return -1;
 }
@@ -780,6 +1060,31 @@ udp_socket_address(struct socket *s, const uint8_t udp_address[UDP_ADDRESS_SIZE]
 	return 0;
 }
 
+// send n datagrams from the list, returns the number sent
+static int
+udp_send_batch(int fd, struct write_buffer *wb, union sockaddr_all *sa, socklen_t *sasz, int n) {
+#ifdef __linux__
+	struct mmsghdr msg[MAX_UDP_BATCH];
+	struct iovec iov[MAX_UDP_BATCH];
+	int i;
+	for (i=0;i<n;i++) {
+		iov[i].iov_base = wb->ptr;
+		iov[i].iov_len = wb->sz;
+		memset(&msg[i], 0, sizeof(msg[i]));
+		msg[i].msg_hdr.msg_name = &sa[i].s;
+		msg[i].msg_hdr.msg_namelen = sasz[i];
+		msg[i].msg_hdr.msg_iov = &iov[i];
+		msg[i].msg_hdr.msg_iovlen = 1;
+		wb = wb->next;
+	}
+	return sendmmsg(fd, msg, n, 0);
+#else
+	if (sendto(fd, wb->ptr, wb->sz, 0, &sa[0].s, sasz[0]) < 0)
+		return -1;
+	return 1;
+#endif
+}
+
 static void
 drop_udp(struct socket_server *ss, struct socket *s, struct wb_list *list, struct write_buffer *tmp) {
 	s->wb_size -= tmp->sz;
@@ -792,45 +1097,49 @@ drop_udp(struct socket_server *ss, struct socket *s, struct wb_list *list, struc
 static int
 send_list_udp(struct socket_server *ss, struct socket *s, struct wb_list *list, struct socket_message *result) {
 	while (list->head) {
+		union sockaddr_all sa[MAX_UDP_BATCH];
+		socklen_t sasz[MAX_UDP_BATCH];
 		struct write_buffer * tmp = list->head;
-		struct write_buffer_udp * udp = (struct write_buffer_udp *)tmp;
-		union sockaddr_all sa;
-		socklen_t sasz = udp_socket_address(s, udp->udp_address, &sa);
-		if (sasz == 0) {
+		int n = 0;
+		while (tmp && n < MAX_UDP_BATCH) {
+			struct write_buffer_udp * udp = (struct write_buffer_udp *)tmp;
+			sasz[n] = udp_socket_address(s, udp->udp_address, &sa[n]);
+			if (sasz[n] == 0)
+				break;
+			++n;
+			tmp = tmp->next;
+		}
+		if (n == 0) {
 			skynet_error(NULL, "socket-server : udp (%d) error: type mismatch.", s->id);
-			drop_udp(ss, s, list, tmp);
+			drop_udp(ss, s, list, list->head);
 			return -1;
 		}
-		int err = sendto(s->fd, tmp->ptr, tmp->sz, 0, &sa.s, sasz);
-		if (err < 0) {
+		int sent = udp_send_batch(s->fd, list->head, sa, sasz, n);
+		if (sent < 0) {
 			switch(errno) {
 			case EINTR:
 			case AGAIN_WOULDBLOCK:
 				return -1;
 			}
 			skynet_error(NULL, "socket-server : udp (%d) sendto error %s.",s->id, strerror(errno));
-			drop_udp(ss, s, list, tmp);
+			drop_udp(ss, s, list, list->head);
 			return -1;
 		}
-		stat_write(ss,s,tmp->sz);
-		s->wb_size -= tmp->sz;
-		list->head = tmp->next;
-		write_buffer_free(ss,tmp);
+		// the datagrams after the first failed one are sent next time
+		int i;
+		for (i=0;i<sent;i++) {
+			tmp = list->head;
+			stat_write(ss,s,tmp->sz);
+			s->wb_size -= tmp->sz;
+			list->head = tmp->next;
+			write_buffer_free(ss,tmp);
+		}
 	}
 	list->tail = NULL;
 
 	return -1;
 }
 
-static int
-send_list(struct socket_server *ss, struct socket *s, struct wb_list *list, struct socket_lock *l, struct socket_message *result) {
-	if (s->protocol == PROTOCOL_TCP) {
-		return send_list_tcp(ss, s, list, l, result);
-	} else {
-		return send_list_udp(ss, s, list, result);
-	}
-}
-
 static inline int
 list_uncomplete(struct wb_list *s) {
 	struct write_buffer *wb = s->head;
@@ -866,15 +1175,23 @@ send_buffer_empty(struct socket *s) {
 	Each socket has two write buffer list, high priority and low priority.
 
 	1. send high list as far as possible.
-	2. If high list is empty, try to send low list.
+	2. If high list is empty, try to send low list. (tcp sends both lists by one writev, see send_list_tcp)
 	3. If low list head is uncomplete (send a part before), move the head of low list to empty high list (call raise_uncomplete) .
 	4. If two lists are both empty, turn off the event. (call check_close)
  */
 static int
 send_buffer_(struct socket_server *ss, struct socket *s, struct socket_lock *l, struct socket_message *result) {
 	assert(!list_uncomplete(&s->low));
-	// step 1
-	int ret = send_list(ss,s,&s->high,l,result);
+	// step 1 and 2
+	int ret;
+	if (s->protocol == PROTOCOL_TCP) {
+		ret = send_list_tcp(ss,s,l,result);
+	} else {
+		ret = send_list_udp(ss,s,&s->high,result);
+		if (s->high.head == NULL && s->low.head != NULL) {
+			ret = send_list_udp(ss,s,&s->low,result);
+		}
+	}
 	if (ret != -1) {
 		if (ret == SOCKET_ERR) {
 			// HALFCLOSE_WRITE
@@ -884,25 +1201,13 @@ send_buffer_(struct socket_server *ss, struct socket *s, struct socket_lock *l,
 		return -1;
 	}
 	if (s->high.head == NULL) {
-		// step 2
-		if (s->low.head != NULL) {
-			int ret = send_list(ss,s,&s->low,l,result);
-			if (ret != -1) {
-				if (ret == SOCKET_ERR) {
-					// HALFCLOSE_WRITE
-					return SOCKET_ERR;
-				}
-				// SOCKET_RST (ignore)
-				return -1;
-			}
-			// step 3
-			if (list_uncomplete(&s->low)) {
-				raise_uncomplete(s);
-				return -1;
-			}
-			if (s->low.head)
-				return -1;
+		// step 3
+		if (list_uncomplete(&s->low)) {
+			raise_uncomplete(s);
+			return -1;
 		}
+		if (s->low.head)
+			return -1;
 		// step 4
 		assert(send_buffer_empty(s) && s->wb_size == 0);
 
@@ -1108,12 +1413,13 @@ listen_socket(struct socket_server *ss, struct request_listen * request, struct
 	socklen_t slen = sizeof(u);
 	if (getsockname(listen_fd, &u.s, &slen) == 0) {
 		void * sin_addr = (u.s.sa_family == AF_INET) ? (void*)&u.v4.sin_addr : (void *)&u.v6.sin6_addr;
-		if (inet_ntop(u.s.sa_family, sin_addr, ss->buffer, sizeof(ss->buffer)) == 0) {
+		char * buffer = socket_poller(ss, id)->buffer;
+		if (inet_ntop(u.s.sa_family, sin_addr, buffer, MAX_INFO) == 0) {
 			result->data = strerror(errno);
 			return SOCKET_ERR;
 		}
 		int sin_port = ntohs((u.s.sa_family == AF_INET) ? u.v4.sin_port : u.v6.sin6_port);
-		result->data = ss->buffer;
+		result->data = buffer;
 		result->ud = sin_port;
 	} else {
 		result->data = strerror(errno);
@@ -1286,13 +1592,13 @@ block_readpipe(int pipefd, void *buffer, int sz) {
 }
 
 static int
-has_cmd(struct socket_server *ss) {
+has_cmd(struct socket_poller *p) {
 	struct timeval tv = {0,0};
 	int retval;
 
-	FD_SET(ss->recvctrl_fd, &ss->rfds);
+	FD_SET(p->recvctrl_fd, &p->rfds);
 
-	retval = select(ss->recvctrl_fd+1, &ss->rfds, NULL, NULL, &tv);
+	retval = select(p->recvctrl_fd+1, &p->rfds, NULL, NULL, &tv);
 	if (retval == 1) {
 		return 1;
 	}
@@ -1397,8 +1703,8 @@ dec_sending_ref(struct socket_server *ss, int id) {
 
 // return type
 static int
-ctrl_cmd(struct socket_server *ss, struct socket_message *result) {
-	int fd = ss->recvctrl_fd;
+ctrl_cmd(struct socket_server *ss, struct socket_poller *p, struct socket_message *result) {
+	int fd = p->recvctrl_fd;
 	// the length of message is one byte, so 256 buffer size is enough.
 	uint8_t buffer[256];
 	uint8_t header[2];
@@ -1460,12 +1766,29 @@ ctrl_cmd(struct socket_server *ss, struct socket_message *result) {
 
 // return -1 (ignore) when error
 static int
-forward_message_tcp(struct socket_server *ss, struct socket *s, struct socket_lock *l, struct socket_message * result) {
+forward_message_tcp(struct socket_server *ss, struct socket *s, struct socket_lock *l, struct socket_message * result, struct event *e) {
 	int sz = s->p.size;
-	char * buffer = MALLOC(sz);
-	int n = (int)read(s->fd, buffer, sz);
+	int cap;	// the size of buffer
+	char * buffer = NULL;
+	int n;
+	if (e->recv) {
+		// received by the poller (io_uring)
+		n = e->size;
+		cap = n;
+		sz = 0;
+		if (n < 0) {
+			errno = -n;
+		} else if (n > 0) {
+			buffer = recv_alloc(ss, n);
+			memcpy(buffer, e->buffer, n);
+		}
+	} else {
+		cap = sz;
+		buffer = recv_alloc(ss, sz);
+		n = (int)read(s->fd, buffer, sz);
+	}
 	if (n<0) {
-		FREE(buffer);
+		recv_free(ss, buffer, cap);
 		switch(errno) {
 		case EINTR:
 		case AGAIN_WOULDBLOCK:
@@ -1476,7 +1799,7 @@ forward_message_tcp(struct socket_server *ss, struct socket *s, struct socket_lo
 		return -1;
 	}
 	if (n==0) {
-		FREE(buffer);
+		recv_free(ss, buffer, cap);
 		if (s->closing) {
 			// Rare case : if s->closing is true, reading event is disable, and SOCKET_CLOSE is raised.
 			if (nomore_sending_data(s)) {
@@ -1500,17 +1823,29 @@ forward_message_tcp(struct socket_server *ss, struct socket *s, struct socket_lo
 
 	if (halfclose_read(s)) {
 		// discard recv data (Rare case : if socket is HALFCLOSE_READ, reading event is disable.)
-		FREE(buffer);
+		recv_free(ss, buffer, cap);
 		return -1;
 	}
 
 	stat_read(ss,s,n);
 
+	if (recv_class(n) != recv_class(cap)) {
+		// The receiver gives the buffer back by the size of data, so move the data into the buffer of its class.
+		char * tmp = recv_alloc(ss, n);
+		memcpy(tmp, buffer, n);
+		recv_free(ss, buffer, cap);
+		buffer = tmp;
+	}
+
 	result->opaque = s->opaque;
 	result->id = s->id;
 	result->ud = n;
 	result->data = buffer;
 
+	if (sz == 0) {
+		// the size is decided by the poller
+		return SOCKET_DATA;
+	}
 	if (n == sz) {
 		s->p.size *= 2;
 		return SOCKET_MORE;
@@ -1539,47 +1874,156 @@ gen_udp_address(int protocol, union sockaddr_all *sa, uint8_t * udp_address) {
 	return addrsz;
 }
 
+// returns the number of datagrams received
+static int
+udp_recv_batch(int fd, struct udp_batch *u) {
+	if (u->buffer == NULL) {
+		u->buffer = MALLOC(MAX_UDP_BATCH * MAX_UDP_PACKAGE);
+	}
+#ifdef __linux__
+	struct mmsghdr msg[MAX_UDP_BATCH];
+	struct iovec iov[MAX_UDP_BATCH];
+	int i;
+	for (i=0;i<MAX_UDP_BATCH;i++) {
+		iov[i].iov_base = u->buffer + i * MAX_UDP_PACKAGE;
+		iov[i].iov_len = MAX_UDP_PACKAGE;
+		memset(&msg[i], 0, sizeof(msg[i]));
+		msg[i].msg_hdr.msg_name = &u->addr[i].s;
+		msg[i].msg_hdr.msg_namelen = sizeof(u->addr[i]);
+		msg[i].msg_hdr.msg_iov = &iov[i];
+		msg[i].msg_hdr.msg_iovlen = 1;
+	}
+	int n = recvmmsg(fd, msg, MAX_UDP_BATCH, 0, NULL);
+	for (i=0;i<n;i++) {
+		u->size[i] = msg[i].msg_len;
+		u->addrsz[i] = msg[i].msg_hdr.msg_namelen;
+	}
+	return n;
+#else
+	u->addrsz[0] = sizeof(u->addr[0]);
+	int n = recvfrom(fd, u->buffer, MAX_UDP_PACKAGE, 0, &u->addr[0].s, &u->addrsz[0]);
+	if (n < 0)
+		return -1;
+	u->size[0] = n;
+	return 1;
+#endif
+}
+
 static int
 forward_message_udp(struct socket_server *ss, struct socket *s, struct socket_lock *l, struct socket_message * result) {
-	union sockaddr_all sa;
-	socklen_t slen = sizeof(sa);
-	int n = recvfrom(s->fd, ss->udpbuffer,MAX_UDP_PACKAGE,0,&sa.s,&slen);
-	if (n<0) {
-		switch(errno) {
-		case EINTR:
-		case AGAIN_WOULDBLOCK:
-			return -1;
+	struct udp_batch *u = &socket_poller(ss, s->id)->udp;
+	for (;;) {
+		if (u->id != s->id || u->index >= u->n) {
+			int n = udp_recv_batch(s->fd, u);
+			if (n<0) {
+				u->n = 0;
+				switch(errno) {
+				case EINTR:
+				case AGAIN_WOULDBLOCK:
+					return -1;
+				}
+				int error = errno;
+				// close when error
+				force_close(ss, s, l, result);
+				result->data = strerror(error);
+				return SOCKET_ERR;
+			}
+			u->id = s->id;
+			u->n = n;
+			u->index = 0;
 		}
-		int error = errno;
-		// close when error
-		force_close(ss, s, l, result);
-		result->data = strerror(error);
-		return SOCKET_ERR;
-	}
-	stat_read(ss,s,n);
+		int i = u->index++;
+		int n = u->size[i];
+		union sockaddr_all *sa = &u->addr[i];
+		stat_read(ss,s,n);
+
+		uint8_t * data;
+		if (u->addrsz[i] == sizeof(sa->v4)) {
+			if (s->protocol != PROTOCOL_UDP)
+				continue;
+			data = MALLOC(n + 1 + 2 + 4);
+			gen_udp_address(PROTOCOL_UDP, sa, data + n);
+		} else {
+			if (s->protocol != PROTOCOL_UDPv6)
+				continue;
+			data = MALLOC(n + 1 + 2 + 16);
+			gen_udp_address(PROTOCOL_UDPv6, sa, data + n);
+		}
+		memcpy(data, u->buffer + i * MAX_UDP_PACKAGE, n);
 
-	uint8_t * data;
-	if (slen == sizeof(sa.v4)) {
-		if (s->protocol != PROTOCOL_UDP)
-			return -1;
-		data = MALLOC(n + 1 + 2 + 4);
-		gen_udp_address(PROTOCOL_UDP, &sa, data + n);
-	} else {
-		if (s->protocol != PROTOCOL_UDPv6)
-			return -1;
-		data = MALLOC(n + 1 + 2 + 16);
-		gen_udp_address(PROTOCOL_UDPv6, &sa, data + n);
+		result->opaque = s->opaque;
+		result->id = s->id;
+		result->ud = n;
+		result->data = (char *)data;
+
+		return SOCKET_UDP;
 	}
-	memcpy(data, ss->udpbuffer, n);
+}
 
-	result->opaque = s->opaque;
-	result->id = s->id;
-	result->ud = n;
-	result->data = (char *)data;
+// The last batch is not full, so the socket is drained after the datagrams left are forwarded.
+static inline bool
+udp_drained(struct socket_server *ss, struct socket *s) {
+	struct udp_batch *u = &socket_poller(ss, s->id)->udp;
+	return u->id == s->id && u->index >= u->n && u->n < MAX_UDP_BATCH;
+}
 
-	return SOCKET_UDP;
+// The datagrams left in the batch, they should be forwarded before the batch is reused by the other sockets.
+static inline bool
+udp_pending(struct socket_server *ss, struct socket *s) {
+	struct udp_batch *u = &socket_poller(ss, s->id)->udp;
+	return u->id == s->id && u->index < u->n;
+}
+
+static inline void
+defer_read(struct socket_poller *p, struct socket *s) {
+#ifdef SP_EDGE_TRIGGERED
+	// There will be no more edge for the data left, read it after the next wait.
+	assert(p->pending_n < MAX_EVENT);
+	p->pending[p->pending_n++] = s->id;
+#endif
+}
+
+// Returns true if the socket of the current event can be read again, or defer it.
+static bool
+read_again(struct socket_poller *p, struct socket *s) {
+	int index = p->event_index - 1;
+	if (p->budget_index != index) {
+		p->budget_index = index;
+		p->budget = MAX_READ_BUDGET;
+	}
+	if (--p->budget > 0)
+		return true;
+	defer_read(p, s);
+	return false;
 }
 
+#ifdef SP_EDGE_TRIGGERED
+// Poll the new events without blocking, and append the sockets deferred as the read events.
+static int
+pending_event(struct socket_server *ss, struct socket_poller *p) {
+	int n = sp_poll(p->event_fd, p->ev, MAX_EVENT - p->pending_n);
+	if (n < 0)
+		n = 0;
+	int i;
+	for (i=0;i<p->pending_n;i++) {
+		int id = p->pending[i];
+		struct socket *s = &ss->slot[HASH_ID(id)];
+		if (socket_invalid(s, id) || !s->reading)
+			continue;
+		struct event *e = &p->ev[n++];
+		memset(e, 0, sizeof(*e));
+		e->s = s;
+		e->read = true;
+	}
+	p->pending_n = 0;
+	if (n == 0) {
+		// all the sockets deferred are closed
+		errno = EINTR;
+	}
+	return n;
+}
+#endif
+
 static int
 report_connect(struct socket_server *ss, struct socket *s, struct socket_lock *l, struct socket_message *result) {
 	int error;
@@ -1606,8 +2050,9 @@ report_connect(struct socket_server *ss, struct socket *s, struct socket_lock *l
 		socklen_t slen = sizeof(u);
 		if (getpeername(s->fd, &u.s, &slen) == 0) {
 			void * sin_addr = (u.s.sa_family == AF_INET) ? (void*)&u.v4.sin_addr : (void *)&u.v6.sin6_addr;
-			if (inet_ntop(u.s.sa_family, sin_addr, ss->buffer, sizeof(ss->buffer))) {
-				result->data = ss->buffer;
+			char * buffer = socket_poller(ss, s->id)->buffer;
+			if (inet_ntop(u.s.sa_family, sin_addr, buffer, MAX_INFO)) {
+				result->data = buffer;
 				return SOCKET_OPEN;
 			}
 		}
@@ -1633,6 +2078,7 @@ getname(union sockaddr_all *u, char *buffer, size_t sz) {
 // return 0 when failed, or -1 when file limit
 static int
 report_accept(struct socket_server *ss, struct socket *s, struct socket_message *result) {
+	struct socket_poller *p = socket_poller(ss, s->id);
 	union sockaddr_all u;
 	socklen_t len = sizeof(u);
 	int client_fd = accept(s->fd, &u.s, &len);
@@ -1644,13 +2090,13 @@ report_accept(struct socket_server *ss, struct socket *s, struct socket_message
 			result->data = strerror(errno);
 
 			// See https://stackoverflow.com/questions/47179793/how-to-gracefully-handle-accept-giving-emfile-and-close-the-connection
-			if (ss->reserve_fd >= 0) {
-				close(ss->reserve_fd);
+			if (p->reserve_fd >= 0) {
+				close(p->reserve_fd);
 				client_fd = accept(s->fd, &u.s, &len);
 				if (client_fd >= 0) {
 					close(client_fd);
 				}
-				ss->reserve_fd = dup(1);
+				p->reserve_fd = dup(1);
 			}
 			return -1;
 		} else {
@@ -1678,56 +2124,60 @@ report_accept(struct socket_server *ss, struct socket *s, struct socket_message
 	result->ud = id;
 	result->data = NULL;
 
-	if (getname(&u, ss->buffer, sizeof(ss->buffer))) {
-		result->data = ss->buffer;
+	if (getname(&u, p->buffer, sizeof(p->buffer))) {
+		result->data = p->buffer;
 	}
 
 	return 1;
 }
 
 static inline void
-clear_closed_event(struct socket_server *ss, struct socket_message * result, int type) {
+clear_closed_event(struct socket_poller *p, struct socket_message * result, int type) {
 	if (type == SOCKET_CLOSE || type == SOCKET_ERR) {
 		int id = result->id;
 		int i;
-		for (i=ss->event_index; i<ss->event_n; i++) {
-			struct event *e = &ss->ev[i];
+		for (i=p->event_index; i<p->event_n; i++) {
+			struct event *e = &p->ev[i];
 			struct socket *s = e->s;
 			if (s) {
 				if (socket_invalid(s, id) && s->id == id) {
+					// io_uring may report more than one event of a socket
 					e->s = NULL;
-					break;
 				}
 			}
 		}
 	}
 }
 
-// return type
-int
-socket_server_poll(struct socket_server *ss, struct socket_message * result, int * more) {
+static int
+poll_socket(struct socket_server *ss, struct socket_poller *p, struct socket_message * result, int * more) {
 	for (;;) {
-		if (ss->checkctrl) {
-			if (has_cmd(ss)) {
-				int type = ctrl_cmd(ss, result);
+		if (p->checkctrl) {
+			if (has_cmd(p)) {
+				int type = ctrl_cmd(ss, p, result);
 				if (type != -1) {
-					clear_closed_event(ss, result, type);
 					return type;
 				} else
 					continue;
 			} else {
-				ss->checkctrl = 0;
+				p->checkctrl = 0;
 			}
 		}
-		if (ss->event_index == ss->event_n) {
-			ss->event_n = sp_wait(ss->event_fd, ss->ev, MAX_EVENT);
-			ss->checkctrl = 1;
+		if (p->event_index == p->event_n) {
+#ifdef SP_EDGE_TRIGGERED
+			if (p->pending_n > 0)
+				p->event_n = pending_event(ss, p);
+			else
+#endif
+			p->event_n = sp_wait(p->event_fd, p->ev, MAX_EVENT);
+			p->checkctrl = 1;
 			if (more) {
 				*more = 0;
 			}
-			ss->event_index = 0;
-			if (ss->event_n <= 0) {
-				ss->event_n = 0;
+			p->event_index = 0;
+			p->budget_index = -1;
+			if (p->event_n <= 0) {
+				p->event_n = 0;
 				int err = errno;
 				if (err != EINTR) {
 					skynet_error(NULL, "socket-server error: %s", strerror(err));
@@ -1735,7 +2185,7 @@ socket_server_poll(struct socket_server *ss, struct socket_message * result, int
 				continue;
 			}
 		}
-		struct event *e = &ss->ev[ss->event_index++];
+		struct event *e = &p->ev[p->event_index++];
 		struct socket *s = e->s;
 		if (s == NULL) {
 			// dispatch pipe message at beginning
@@ -1745,12 +2195,45 @@ socket_server_poll(struct socket_server *ss, struct socket_message * result, int
 		socket_lock_init(s, &l);
 		switch (ATOM_LOAD(&s->type)) {
 		case SOCKET_TYPE_CONNECTING:
+			if (e->recv) {
+				if (e->size < 0) {
+					force_close(ss, s, &l, result);
+					result->data = strerror(-e->size);
+					return SOCKET_ERR;
+				} else {
+					int type = report_connect(ss, s, &l, result);
+					if (type == SOCKET_OPEN) {
+						// forward the received data next step
+						--p->event_index;
+					}
+					return type;
+				}
+			}
+#ifdef SP_EDGE_TRIGGERED
+			{
+				int type = report_connect(ss, s, &l, result);
+				if (type == SOCKET_OPEN) {
+					// The edges of the data (or eof) and the buffer queued may come with the connection,
+					// dispatch the event again.
+					--p->event_index;
+				}
+				return type;
+			}
+#else
 			return report_connect(ss, s, &l, result);
+#endif
 		case SOCKET_TYPE_LISTEN: {
 			int ok = report_accept(ss, s, result);
 			if (ok > 0) {
+#ifdef SP_EDGE_TRIGGERED
+				// accept until EAGAIN
+				if (read_again(p, s))
+					--p->event_index;
+#endif
 				return SOCKET_ACCEPT;
 			} if (ok < 0 ) {
+				// EMFILE, retry later
+				defer_read(p, s);
 				return SOCKET_ERR;
 			}
 			// when ok == 0, retry
@@ -1760,26 +2243,40 @@ socket_server_poll(struct socket_server *ss, struct socket_message * result, int
 			skynet_error(NULL, "socket-server error: invalid socket");
 			break;
 		default:
+			if (e->write && !s->writing) {
+				// edge triggered mode keeps EPOLLOUT, see enable_write
+				e->write = false;
+			}
 			if (e->read) {
 				int type;
 				if (s->protocol == PROTOCOL_TCP) {
-					type = forward_message_tcp(ss, s, &l, result);
+					type = forward_message_tcp(ss, s, &l, result, e);
 					if (type == SOCKET_MORE) {
-						--ss->event_index;
+						if (read_again(p, s)) {
+							--p->event_index;
+						} else if (e->write) {
+							e->read = false;
+							--p->event_index;
+						}
 						return SOCKET_DATA;
 					}
 				} else {
 					type = forward_message_udp(ss, s, &l, result);
 					if (type == SOCKET_UDP) {
-						// try read again
-						--ss->event_index;
+						if (udp_pending(ss, s) || (!udp_drained(ss, s) && read_again(p, s))) {
+							// try read again
+							--p->event_index;
+						} else if (e->write) {
+							e->read = false;
+							--p->event_index;
+						}
 						return SOCKET_UDP;
 					}
 				}
 				if (e->write && type != SOCKET_CLOSE && type != SOCKET_ERR) {
 					// Try to dispatch write message next step if write flag set.
 					e->read = false;
-					--ss->event_index;
+					--p->event_index;
 				}
 				if (type == -1)
 					break;
@@ -1819,13 +2316,24 @@ socket_server_poll(struct socket_server *ss, struct socket_message * result, int
 	}
 }
 
+// return type
+int
+socket_server_poll(struct socket_server *ss, int poller, struct socket_message * result, int * more) {
+	struct socket_poller *p = &ss->poller[poller];
+	int type = poll_socket(ss, p, result, more);
+	clear_closed_event(p, result, type);
+	return type;
+}
+
+// send the request to the poller of the socket id
 static void
-send_request(struct socket_server *ss, struct request_package *request, char type, int len) {
+send_request(struct socket_server *ss, int id, struct request_package *request, char type, int len) {
 	request->header[6] = (uint8_t)type;
 	request->header[7] = (uint8_t)len;
 	const char * req = (const char *)request + offsetof(struct request_package, header[6]);
+	int fd = socket_poller(ss, id)->sendctrl_fd;
 	for (;;) {
-		ssize_t n = write(ss->sendctrl_fd, req, len+2);
+		ssize_t n = write(fd, req, len+2);
 		if (n<0) {
 			if (errno != EINTR) {
 				skynet_error(NULL, "socket-server : send ctrl command error %s.", strerror(errno));
@@ -1868,7 +2376,7 @@ socket_server_connect(struct socket_server *ss, uintptr_t opaque, const char * a
 	int len = open_request(ss, &request, opaque, addr, port);
 	if (len < 0)
 		return -1;
-	send_request(ss, &request, 'O', sizeof(request.u.open) + len);
+	send_request(ss, request.u.open.id, &request, 'O', sizeof(request.u.open) + len);
 	return request.u.open.id;
 }
 
@@ -1934,7 +2442,7 @@ socket_server_send(struct socket_server *ss, struct socket_sendbuffer *buf) {
 			request.u.send.buffer = NULL;
 
 			// let socket thread enable write event
-			send_request(ss, &request, 'W', sizeof(request.u.send));
+			send_request(ss, id, &request, 'W', sizeof(request.u.send));
 
 			return 0;
 		}
@@ -1948,7 +2456,7 @@ socket_server_send(struct socket_server *ss, struct socket_sendbuffer *buf) {
 	request.u.send.id = id;
 	request.u.send.buffer = clone_buffer(buf, &request.u.send.sz);
 
-	send_request(ss, &request, 'D', sizeof(request.u.send));
+	send_request(ss, id, &request, 'D', sizeof(request.u.send));
 	return 0;
 }
 
@@ -1970,15 +2478,19 @@ socket_server_send_lowpriority(struct socket_server *ss, struct socket_sendbuffe
 	request.u.send.id = id;
 	request.u.send.buffer = clone_buffer(buf, &request.u.send.sz);
 
-	send_request(ss, &request, 'P', sizeof(request.u.send));
+	send_request(ss, id, &request, 'P', sizeof(request.u.send));
 	return 0;
 }
 
 void
 socket_server_exit(struct socket_server *ss) {
-	struct request_package request;
-	request_init(&request);
-	send_request(ss, &request, 'X', 0);
+	int i;
+	for (i=0;i<ss->poller_n;i++) {
+		struct request_package request;
+		request_init(&request);
+		// the socket id i is in the poller i
+		send_request(ss, i, &request, 'X', 0);
+	}
 }
 
 void
@@ -1988,7 +2500,7 @@ socket_server_close(struct socket_server *ss, uintptr_t opaque, int id) {
 	request.u.close.id = id;
 	request.u.close.shutdown = 0;
 	request.u.close.opaque = opaque;
-	send_request(ss, &request, 'K', sizeof(request.u.close));
+	send_request(ss, id, &request, 'K', sizeof(request.u.close));
 }
 
 
@@ -1999,13 +2511,13 @@ socket_server_shutdown(struct socket_server *ss, uintptr_t opaque, int id) {
 	request.u.close.id = id;
 	request.u.close.shutdown = 1;
 	request.u.close.opaque = opaque;
-	send_request(ss, &request, 'K', sizeof(request.u.close));
+	send_request(ss, id, &request, 'K', sizeof(request.u.close));
 }
 
 // return -1 means failed
 // or return AF_INET or AF_INET6
 static int
-do_bind(const char *host, int port, int protocol, int *family) {
+do_bind(const char *host, int port, int protocol, int *family, bool reuseport) {
 	int fd;
 	int status;
 	int reuse = 1;
@@ -2038,6 +2550,15 @@ do_bind(const char *host, int port, int protocol, int *family) {
 	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void *)&reuse, sizeof(int))==-1) {
 		goto _failed;
 	}
+	if (reuseport) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (void *)&reuse, sizeof(int))==-1) {
+			goto _failed;
+		}
+#else
+		goto _failed;
+#endif
+	}
 	status = bind(fd, (struct sockaddr *)ai_list->ai_addr, ai_list->ai_addrlen);
 	if (status != 0)
 		goto _failed;
@@ -2052,9 +2573,9 @@ _failed_fd:
 }
 
 static int
-do_listen(const char * host, int port, int backlog) {
+do_listen(const char * host, int port, int backlog, bool reuseport) {
 	int family = 0;
-	int listen_fd = do_bind(host, port, IPPROTO_TCP, &family);
+	int listen_fd = do_bind(host, port, IPPROTO_TCP, &family, reuseport);
 	if (listen_fd < 0) {
 		return -1;
 	}
@@ -2062,12 +2583,16 @@ do_listen(const char * host, int port, int backlog) {
 		close(listen_fd);
 		return -1;
 	}
+#ifdef SP_EDGE_TRIGGERED
+	// accept until EAGAIN
+	sp_nonblocking(listen_fd);
+#endif
 	return listen_fd;
 }
 
-int
-socket_server_listen(struct socket_server *ss, uintptr_t opaque, const char * addr, int port, int backlog) {
-	int fd = do_listen(addr, port, backlog);
+static int
+listen_socket_request(struct socket_server *ss, uintptr_t opaque, const char * addr, int port, int backlog, bool reuseport) {
+	int fd = do_listen(addr, port, backlog, reuseport);
 	if (fd < 0) {
 		return -1;
 	}
@@ -2081,10 +2606,22 @@ socket_server_listen(struct socket_server *ss, uintptr_t opaque, const char * ad
 	request.u.listen.opaque = opaque;
 	request.u.listen.id = id;
 	request.u.listen.fd = fd;
-	send_request(ss, &request, 'L', sizeof(request.u.listen));
+	send_request(ss, id, &request, 'L', sizeof(request.u.listen));
 	return id;
 }
 
+int
+socket_server_listen(struct socket_server *ss, uintptr_t opaque, const char * addr, int port, int backlog) {
+	return listen_socket_request(ss, opaque, addr, port, backlog, false);
+}
+
+// Each member of the group listens on the same port with its own socket (SO_REUSEPORT),
+// and the kernel spreads the incoming connections among them.
+int
+socket_server_reuseport_listen(struct socket_server *ss, uintptr_t opaque, const char * addr, int port, int backlog) {
+	return listen_socket_request(ss, opaque, addr, port, backlog, true);
+}
+
 int
 socket_server_bind(struct socket_server *ss, uintptr_t opaque, int fd) {
 	struct request_package request;
@@ -2095,7 +2632,7 @@ socket_server_bind(struct socket_server *ss, uintptr_t opaque, int fd) {
 	request.u.bind.opaque = opaque;
 	request.u.bind.id = id;
 	request.u.bind.fd = fd;
-	send_request(ss, &request, 'B', sizeof(request.u.bind));
+	send_request(ss, id, &request, 'B', sizeof(request.u.bind));
 	return id;
 }
 
@@ -2105,7 +2642,7 @@ socket_server_start(struct socket_server *ss, uintptr_t opaque, int id) {
 	request_init(&request);
 	request.u.resumepause.id = id;
 	request.u.resumepause.opaque = opaque;
-	send_request(ss, &request, 'R', sizeof(request.u.resumepause));
+	send_request(ss, id, &request, 'R', sizeof(request.u.resumepause));
 }
 
 void
@@ -2114,7 +2651,7 @@ socket_server_pause(struct socket_server *ss, uintptr_t opaque, int id) {
 	request_init(&request);
 	request.u.resumepause.id = id;
 	request.u.resumepause.opaque = opaque;
-	send_request(ss, &request, 'S', sizeof(request.u.resumepause));
+	send_request(ss, id, &request, 'S', sizeof(request.u.resumepause));
 }
 
 void
@@ -2124,7 +2661,7 @@ socket_server_nodelay(struct socket_server *ss, int id) {
 	request.u.setopt.id = id;
 	request.u.setopt.what = TCP_NODELAY;
 	request.u.setopt.value = 1;
-	send_request(ss, &request, 'T', sizeof(request.u.setopt));
+	send_request(ss, id, &request, 'T', sizeof(request.u.setopt));
 }
 
 void
@@ -2140,7 +2677,7 @@ socket_server_udp(struct socket_server *ss, uintptr_t opaque, const char * addr,
 	int family;
 	if (port != 0 || addr != NULL) {
 		// bind
-		fd = do_bind(addr, port, IPPROTO_UDP, &family);
+		fd = do_bind(addr, port, IPPROTO_UDP, &family, false);
 		if (fd < 0) {
 			return -1;
 		}
@@ -2165,7 +2702,7 @@ socket_server_udp(struct socket_server *ss, uintptr_t opaque, const char * addr,
 	request.u.udp.opaque = opaque;
 	request.u.udp.family = family;
 
-	send_request(ss, &request, 'U', sizeof(request.u.udp));
+	send_request(ss, id, &request, 'U', sizeof(request.u.udp));
 	return id;
 }
 
@@ -2178,7 +2715,7 @@ socket_server_udp_listen(struct socket_server *ss, uintptr_t opaque, const char*
 
 	int family;
 	// bind
-	fd = do_bind(addr, port, IPPROTO_UDP, &family);
+	fd = do_bind(addr, port, IPPROTO_UDP, &family, false);
 	if (fd < 0) {
 		return -1;
 	}
@@ -2197,7 +2734,7 @@ socket_server_udp_listen(struct socket_server *ss, uintptr_t opaque, const char*
 	request.u.udp.opaque = opaque;
 	request.u.udp.family = family;
 
-	send_request(ss, &request, 'U', sizeof(request.u.udp));
+	send_request(ss, id, &request, 'U', sizeof(request.u.udp));
 	return id;
 }
 
@@ -2253,7 +2790,7 @@ socket_server_udp_dial(struct socket_server *ss, uintptr_t opaque, const char* a
 
 	freeaddrinfo( ai_list );
 
-	send_request(ss, &request, 'N', sizeof(request.u.dial_udp) - sizeof(request.u.dial_udp.address) + addrsz);
+	send_request(ss, id, &request, 'N', sizeof(request.u.dial_udp) - sizeof(request.u.dial_udp.address) + addrsz);
 	return id;
 }
 
@@ -2316,7 +2853,7 @@ socket_server_udp_send(struct socket_server *ss, const struct socket_udp_address
 
 	memcpy(request.u.send_udp.address, udp_address, addrsz);
 
-	send_request(ss, &request, 'A', sizeof(request.u.send_udp.send)+addrsz);
+	send_request(ss, id, &request, 'A', sizeof(request.u.send_udp.send)+addrsz);
 	return 0;
 }
 
@@ -2368,7 +2905,7 @@ socket_server_udp_connect(struct socket_server *ss, int id, const char * addr, i
 
 	freeaddrinfo( ai_list );
 
-	send_request(ss, &request, 'C', sizeof(request.u.set_udp) - sizeof(request.u.set_udp.address) +addrsz);
+	send_request(ss, id, &request, 'C', sizeof(request.u.set_udp) - sizeof(request.u.set_udp.address) +addrsz);
 
 	return 0;
 }
@@ -27,10 +27,16 @@ struct socket_message {
 	char * data;
 };
 
-struct socket_server * socket_server_create(uint64_t time);
+// the sockets are sharded across the poller threads by id, call socket_server_poll in each poller thread
+struct socket_server * socket_server_create(uint64_t time, int poller);
 void socket_server_release(struct socket_server *);
 void socket_server_updatetime(struct socket_server *, uint64_t time);
-int socket_server_poll(struct socket_server *, struct socket_message *result, int *more);
+int socket_server_poll(struct socket_server *, int poller, struct socket_message *result, int *more);
+
+// The buffer of SOCKET_DATA comes from a pool, give it back with the size of data (result->ud).
+// It's ok to free it by skynet_free, but it can't be reused.
+void socket_server_freebuffer(struct socket_server *, void *buffer, int sz);
+void socket_server_poolstat(struct socket_server *, struct socket_pool_stat *stat);
 
 void socket_server_exit(struct socket_server *);
 void socket_server_close(struct socket_server *, uintptr_t opaque, int id);
@@ -44,6 +50,7 @@ int socket_server_send_lowpriority(struct socket_server *, struct socket_sendbuf
 
 // ctrl command below returns id
 int socket_server_listen(struct socket_server *, uintptr_t opaque, const char * addr, int port, int backlog);
+int socket_server_reuseport_listen(struct socket_server *, uintptr_t opaque, const char * addr, int port, int backlog);
 int socket_server_connect(struct socket_server *, uintptr_t opaque, const char * addr, int port);
 int socket_server_bind(struct socket_server *, uintptr_t opaque, int fd);
 
@@ -0,0 +1,641 @@
+#ifndef poll_socket_uring_h
+#define poll_socket_uring_h
+
+// io_uring backend, build with -DUSE_IO_URING (linux 6.0+, or see the fallback below).
+// The stream sockets are read by multishot recv with a provided buffer ring, so the data comes with the event
+// (event.recv), and socket_server doesn't call read(). The other fds (ctrl pipe, listen and udp sockets) use
+// oneshot poll, which is armed again after the event to keep the level triggered semantics of epoll.
+// All the requests are submitted in batch by sp_wait.
+// Only the reading is done by io_uring. socket_server still writes by write/writev (the direct write of the worker
+// threads, and the write list when POLLOUT is reported), because a submitted send would hold the write buffers
+// until its completion, even after the socket is closed.
+// sp_create falls back to epoll at runtime when the ring can't be set up (ie. linux < 5.19 without pbuf ring),
+// and the stream sockets are polled too if the multishot recv isn't supported (linux < 6.0).
+
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+
+#include "atomic.h"
+#include "spinlock.h"
+#include "skynet_malloc.h"
+
+#define SP_URING_ENTRIES 256
+#define SP_URING_BUFFER_SIZE 8192
+#define SP_URING_BUFFER_COUNT 256	// power of 2
+#define SP_URING_BGID 0
+
+#define SP_URING_READ 1
+#define SP_URING_WRITE 2
+#define SP_URING_CANCEL 3
+
+#define SP_URING_MODE_POLL 0
+#define SP_URING_MODE_RECV 1
+
+struct sp_uring_fd {
+	void * ud;
+	uint32_t gen;	// drop the completions of the closed fd
+	uint8_t mode;
+	bool read_enable;
+	bool write_enable;
+	bool read_armed;
+	bool write_armed;
+	bool read_rearm;	// arm the read again after the cancel completes
+};
+
+struct sp_uring {
+	int fd;
+	int efd;	// epoll fd if io_uring isn't available, or -1
+	bool recv_multishot;
+	struct spinlock lock;
+	// submission queue
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	// completion queue
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr;
+	size_t sq_sz;
+	void *cq_ptr;
+	size_t cq_sz;
+	size_t sqes_sz;
+	// provided buffers
+	struct io_uring_buf_ring *br;
+	size_t br_sz;
+	char *buffer;
+	uint16_t br_tail;
+	int recycle_n;
+	uint16_t recycle[SP_URING_BUFFER_COUNT];
+	// the fds to arm again in next sp_wait
+	int rearm_n;
+	int rearm_cap;
+	uint64_t *rearm;
+	int fd_cap;
+	struct sp_uring_fd *fds;
+};
+
+typedef struct sp_uring * sp_uring_t;
+
+static inline uint64_t
+sp_uring_data(int fd, uint32_t gen, int op) {
+	return (uint64_t)(uint32_t)fd | (uint64_t)(gen & 0xffffff) << 32 | (uint64_t)op << 56;
+}
+
+static bool
+sp_invalid(sp_uring_t u) {
+	return u == NULL;
+}
+
+static void
+sp_uring_buffer_add(struct sp_uring *u, uint16_t bid) {
+	struct io_uring_buf *buf = &u->br->bufs[u->br_tail & (SP_URING_BUFFER_COUNT - 1)];
+	buf->addr = (uint64_t)(uintptr_t)(u->buffer + (size_t)bid * SP_URING_BUFFER_SIZE);
+	buf->len = SP_URING_BUFFER_SIZE;
+	buf->bid = bid;
+	++u->br_tail;
+}
+
+static inline void
+sp_uring_buffer_commit(struct sp_uring *u) {
+	__atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+static void
+sp_release(sp_uring_t u) {
+	if (u == NULL)
+		return;
+	if (u->efd >= 0) {
+		close(u->efd);
+		skynet_free(u);
+		return;
+	}
+	close(u->fd);
+	munmap(u->sqes, u->sqes_sz);
+	if (u->cq_ptr != u->sq_ptr)
+		munmap(u->cq_ptr, u->cq_sz);
+	munmap(u->sq_ptr, u->sq_sz);
+	munmap(u->br, u->br_sz);
+	skynet_free(u->buffer);
+	skynet_free(u->rearm);
+	skynet_free(u->fds);
+	spinlock_destroy(&u->lock);
+	skynet_free(u);
+}
+
+static sp_uring_t
+sp_uring_new() {
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	// don't stop the batch at a bad request (ie. multishot recv on linux < 6.0), see sp_uring_event
+	p.flags = IORING_SETUP_SUBMIT_ALL;
+	int fd = syscall(__NR_io_uring_setup, SP_URING_ENTRIES, &p);
+	if (fd < 0)
+		return NULL;
+	struct sp_uring *u = skynet_malloc(sizeof(*u));
+	memset(u, 0, sizeof(*u));
+	u->fd = fd;
+	u->efd = -1;
+	u->recv_multishot = true;
+	spinlock_init(&u->lock);
+
+	u->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	u->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_sz > u->sq_sz)
+			u->sq_sz = u->cq_sz;
+		u->cq_sz = u->sq_sz;
+	}
+	u->sq_ptr = mmap(NULL, u->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (u->sq_ptr == MAP_FAILED) {
+		close(fd);
+		skynet_free(u);
+		return NULL;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		u->cq_ptr = u->sq_ptr;
+	} else {
+		u->cq_ptr = mmap(NULL, u->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (u->cq_ptr == MAP_FAILED) {
+			munmap(u->sq_ptr, u->sq_sz);
+			close(fd);
+			skynet_free(u);
+			return NULL;
+		}
+	}
+	u->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	char *sq = u->sq_ptr;
+	char *cq = u->cq_ptr;
+	u->sq_head = (unsigned *)(sq + p.sq_off.head);
+	u->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	u->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	u->sq_array = (unsigned *)(sq + p.sq_off.array);
+	u->cq_head = (unsigned *)(cq + p.cq_off.head);
+	u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	u->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	// provided buffer ring for recv
+	u->br_sz = SP_URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+	u->br = mmap(NULL, u->br_sz, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	u->buffer = skynet_malloc((size_t)SP_URING_BUFFER_COUNT * SP_URING_BUFFER_SIZE);
+	if (u->sqes == MAP_FAILED || u->br == MAP_FAILED) {
+		if (u->sqes == MAP_FAILED)
+			u->sqes = NULL;
+		if (u->br == MAP_FAILED)
+			u->br = NULL;
+		sp_release(u);
+		return NULL;
+	}
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+	reg.ring_entries = SP_URING_BUFFER_COUNT;
+	reg.bgid = SP_URING_BGID;
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		sp_release(u);
+		return NULL;
+	}
+	int i;
+	for (i=0;i<SP_URING_BUFFER_COUNT;i++) {
+		sp_uring_buffer_add(u, i);
+	}
+	sp_uring_buffer_commit(u);
+	return u;
+}
+
+static sp_uring_t
+sp_uring_epoll() {
+	int efd = epoll_create(1024);
+	if (efd == -1)
+		return NULL;
+	struct sp_uring *u = skynet_malloc(sizeof(*u));
+	memset(u, 0, sizeof(*u));
+	u->fd = -1;
+	u->efd = efd;
+	return u;
+}
+
+static sp_uring_t
+sp_create() {
+	static bool report = false;
+	sp_uring_t u = sp_uring_new();
+	if (u == NULL) {
+		if (!report) {
+			report = true;
+			// socket_server starts before the logger
+			fprintf(stderr, "socket-server: io_uring setup failed (%s), use epoll instead.\n", strerror(errno));
+		}
+		u = sp_uring_epoll();
+	}
+	return u;
+}
+
+static int
+sp_epoll_ctl(sp_uring_t u, int op, int sock, void *ud, bool read_enable, bool write_enable) {
+	struct epoll_event ev;
+	ev.events = (read_enable ? EPOLLIN : 0) | (write_enable ? EPOLLOUT : 0);
+	ev.data.ptr = ud;
+	if (epoll_ctl(u->efd, op, sock, &ev) == -1) {
+		return 1;
+	}
+	return 0;
+}
+
+static int
+sp_epoll_wait(sp_uring_t u, struct event *e, int max) {
+	struct epoll_event ev[max];
+	int n = epoll_wait(u->efd, ev, max, -1);
+	int i;
+	for (i=0;i<n;i++) {
+		e[i].s = ev[i].data.ptr;
+		unsigned flag = ev[i].events;
+		e[i].write = (flag & EPOLLOUT) != 0;
+		e[i].read = (flag & EPOLLIN) != 0;
+		e[i].error = (flag & EPOLLERR) != 0;
+		e[i].eof = (flag & EPOLLHUP) != 0;
+		e[i].recv = false;
+		e[i].size = 0;
+		e[i].buffer = NULL;
+	}
+	return n;
+}
+
+static inline int
+sp_uring_enter(struct sp_uring *u, unsigned submit, int wait) {
+	return syscall(__NR_io_uring_enter, u->fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+// the requests not consumed by the kernel yet (with u->lock)
+static inline unsigned
+sp_uring_pending(struct sp_uring *u) {
+	return *u->sq_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+}
+
+// with u->lock
+static int
+sp_uring_submit(struct sp_uring *u) {
+	return sp_uring_enter(u, sp_uring_pending(u), 0);
+}
+
+// with u->lock
+static struct io_uring_sqe *
+sp_uring_sqe(struct sp_uring *u) {
+	unsigned tail = *u->sq_tail;
+	unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+	if (tail - head >= SP_URING_ENTRIES) {
+		// full, submit them
+		sp_uring_submit(u);
+		head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+		if (tail - head >= SP_URING_ENTRIES)
+			return NULL;
+	}
+	unsigned idx = tail & *u->sq_mask;
+	struct io_uring_sqe *sqe = &u->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	u->sq_array[idx] = idx;
+	return sqe;
+}
+
+static inline void
+sp_uring_push(struct sp_uring *u) {
+	__atomic_store_n(u->sq_tail, *u->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static struct sp_uring_fd *
+sp_uring_getfd(struct sp_uring *u, int sock) {
+	if (sock >= u->fd_cap) {
+		int cap = u->fd_cap ? u->fd_cap : 1024;
+		while (cap <= sock)
+			cap *= 2;
+		u->fds = skynet_realloc(u->fds, cap * sizeof(struct sp_uring_fd));
+		memset(u->fds + u->fd_cap, 0, (cap - u->fd_cap) * sizeof(struct sp_uring_fd));
+		u->fd_cap = cap;
+	}
+	return &u->fds[sock];
+}
+
+static void
+sp_uring_arm_read(struct sp_uring *u, int sock, struct sp_uring_fd *f) {
+	struct io_uring_sqe *sqe = sp_uring_sqe(u);
+	if (sqe == NULL)
+		return;
+	sqe->fd = sock;
+	sqe->user_data = sp_uring_data(sock, f->gen, SP_URING_READ);
+	if (f->mode == SP_URING_MODE_RECV) {
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = SP_URING_BGID;
+	} else {
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = POLLIN;
+	}
+	sp_uring_push(u);
+	f->read_armed = true;
+}
+
+static void
+sp_uring_arm_write(struct sp_uring *u, int sock, struct sp_uring_fd *f) {
+	struct io_uring_sqe *sqe = sp_uring_sqe(u);
+	if (sqe == NULL)
+		return;
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = sock;
+	sqe->poll32_events = POLLOUT;
+	sqe->user_data = sp_uring_data(sock, f->gen, SP_URING_WRITE);
+	sp_uring_push(u);
+	f->write_armed = true;
+}
+
+static void
+sp_uring_cancel(struct sp_uring *u, int sock, uint32_t gen, int op) {
+	struct io_uring_sqe *sqe = sp_uring_sqe(u);
+	if (sqe == NULL)
+		return;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = sp_uring_data(sock, gen, op);
+	sqe->user_data = sp_uring_data(sock, gen, SP_URING_CANCEL);
+	sp_uring_push(u);
+}
+
+static int
+sp_add(sp_uring_t u, int sock, void *ud, bool read_enable) {
+	if (u->efd >= 0)
+		return sp_epoll_ctl(u, EPOLL_CTL_ADD, sock, ud, read_enable, false);
+	int type = 0;
+	int listen = 0;
+	socklen_t len = sizeof(type);
+	int mode = SP_URING_MODE_POLL;
+	if (u->recv_multishot && getsockopt(sock, SOL_SOCKET, SO_TYPE, &type, &len) == 0 && type == SOCK_STREAM) {
+		len = sizeof(listen);
+		if (getsockopt(sock, SOL_SOCKET, SO_ACCEPTCONN, &listen, &len) == 0 && !listen) {
+			mode = SP_URING_MODE_RECV;
+		}
+	}
+	spinlock_lock(&u->lock);
+	struct sp_uring_fd *f = sp_uring_getfd(u, sock);
+	uint32_t gen = f->gen + 1;
+	memset(f, 0, sizeof(*f));
+	f->gen = gen;
+	f->ud = ud;
+	f->mode = mode;
+	f->read_enable = read_enable;
+	if (read_enable) {
+		sp_uring_arm_read(u, sock, f);
+	}
+	spinlock_unlock(&u->lock);
+	return 0;
+}
+
+static void
+sp_del(sp_uring_t u, int sock) {
+	if (u->efd >= 0) {
+		epoll_ctl(u->efd, EPOLL_CTL_DEL, sock, NULL);
+		return;
+	}
+	spinlock_lock(&u->lock);
+	if (sock < u->fd_cap) {
+		struct sp_uring_fd *f = &u->fds[sock];
+		if (f->read_armed)
+			sp_uring_cancel(u, sock, f->gen, SP_URING_READ);
+		if (f->write_armed)
+			sp_uring_cancel(u, sock, f->gen, SP_URING_WRITE);
+		uint32_t gen = f->gen + 1;
+		memset(f, 0, sizeof(*f));
+		f->gen = gen;
+		// submit the cancel now, the socket is closing and the pending requests hold it.
+		if (sp_uring_pending(u))
+			sp_uring_submit(u);
+	}
+	spinlock_unlock(&u->lock);
+}
+
+static int
+sp_enable(sp_uring_t u, int sock, void *ud, bool read_enable, bool write_enable) {
+	if (u->efd >= 0)
+		return sp_epoll_ctl(u, EPOLL_CTL_MOD, sock, ud, read_enable, write_enable);
+	spinlock_lock(&u->lock);
+	struct sp_uring_fd *f = sp_uring_getfd(u, sock);
+	f->ud = ud;
+	if (read_enable != f->read_enable) {
+		f->read_enable = read_enable;
+		if (read_enable) {
+			if (!f->read_armed) {
+				sp_uring_arm_read(u, sock, f);
+			} else {
+				f->read_rearm = true;
+			}
+		} else if (f->read_armed) {
+			f->read_rearm = false;
+			sp_uring_cancel(u, sock, f->gen, SP_URING_READ);
+		}
+	}
+	f->write_enable = write_enable;
+	if (write_enable && !f->write_armed) {
+		sp_uring_arm_write(u, sock, f);
+	}
+	spinlock_unlock(&u->lock);
+	return 0;
+}
+
+static void
+sp_uring_rearm(struct sp_uring *u, int sock, uint32_t gen) {
+	if (u->rearm_n >= u->rearm_cap) {
+		u->rearm_cap = u->rearm_cap ? u->rearm_cap * 2 : 64;
+		u->rearm = skynet_realloc(u->rearm, u->rearm_cap * sizeof(uint64_t));
+	}
+	u->rearm[u->rearm_n++] = sp_uring_data(sock, gen, 0);
+}
+
+// convert a completion to the event, returns 0 if it should be ignored (with u->lock)
+static int
+sp_uring_event(struct sp_uring *u, struct io_uring_cqe *cqe, struct event *e) {
+	uint64_t data = cqe->user_data;
+	int sock = (int)(uint32_t)data;
+	uint32_t gen = (uint32_t)(data >> 32) & 0xffffff;
+	int op = (int)(data >> 56);
+	int res = cqe->res;
+	unsigned flags = cqe->flags;
+	bool more = (flags & IORING_CQE_F_MORE) != 0;
+	if (flags & IORING_CQE_F_BUFFER) {
+		uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+		// give it back after the event is handled, see sp_wait
+		u->recycle[u->recycle_n++] = bid;
+		e->buffer = u->buffer + (size_t)bid * SP_URING_BUFFER_SIZE;
+	} else {
+		e->buffer = NULL;
+	}
+	if (op == SP_URING_CANCEL || sock >= u->fd_cap)
+		return 0;
+	struct sp_uring_fd *f = &u->fds[sock];
+	if ((f->gen & 0xffffff) != gen) {
+		// closed
+		return 0;
+	}
+	e->s = f->ud;
+	e->read = false;
+	e->write = false;
+	e->error = false;
+	e->eof = false;
+	e->recv = false;
+	e->size = 0;
+	if (op == SP_URING_WRITE) {
+		f->write_armed = false;
+		if (!f->write_enable)
+			return 0;
+		sp_uring_rearm(u, sock, f->gen);
+		if (res < 0) {
+			e->error = true;
+		} else {
+			e->write = (res & POLLOUT) != 0;
+			e->error = (res & POLLERR) != 0;
+			e->eof = (res & POLLHUP) != 0;
+		}
+		return 1;
+	}
+	// SP_URING_READ
+	if (!more) {
+		f->read_armed = false;
+		if (f->read_rearm) {
+			f->read_rearm = false;
+			sp_uring_rearm(u, sock, f->gen);
+		}
+	}
+	if (f->mode == SP_URING_MODE_POLL) {
+		if (!f->read_enable)
+			return 0;
+		sp_uring_rearm(u, sock, f->gen);
+		if (res < 0) {
+			e->error = true;
+		} else {
+			e->read = (res & POLLIN) != 0;
+			e->error = (res & POLLERR) != 0;
+			e->eof = (res & POLLHUP) != 0;
+		}
+		return 1;
+	}
+	// multishot recv
+	if (res == -ECANCELED)
+		return 0;
+	if (res == -EINVAL && !more) {
+		// multishot recv isn't supported, poll this socket and the new ones instead
+		u->recv_multishot = false;
+		f->mode = SP_URING_MODE_POLL;
+		if (f->read_enable)
+			sp_uring_rearm(u, sock, f->gen);
+		return 0;
+	}
+	if (res == -ENOBUFS) {
+		// out of buffers, try again next time
+		if (!more && f->read_enable)
+			sp_uring_rearm(u, sock, f->gen);
+		return 0;
+	}
+	if (!more && res > 0 && f->read_enable) {
+		sp_uring_rearm(u, sock, f->gen);
+	}
+	// The data is received already, deliver it even if the reading is disabled just now.
+	e->read = true;
+	e->recv = true;
+	e->size = res;
+	return 1;
+}
+
+static int
+sp_wait(sp_uring_t u, struct event *e, int max) {
+	if (u->efd >= 0)
+		return sp_epoll_wait(u, e, max);
+	int i;
+	spinlock_lock(&u->lock);
+	// the buffers of the last events are handled
+	for (i=0;i<u->recycle_n;i++) {
+		sp_uring_buffer_add(u, u->recycle[i]);
+	}
+	if (u->recycle_n > 0) {
+		u->recycle_n = 0;
+		sp_uring_buffer_commit(u);
+	}
+	for (i=0;i<u->rearm_n;i++) {
+		uint64_t data = u->rearm[i];
+		int sock = (int)(uint32_t)data;
+		uint32_t gen = (uint32_t)(data >> 32);
+		if (sock >= u->fd_cap)
+			continue;
+		struct sp_uring_fd *f = &u->fds[sock];
+		if ((f->gen & 0xffffff) != gen)
+			continue;
+		if (f->read_enable && !f->read_armed)
+			sp_uring_arm_read(u, sock, f);
+		if (f->write_enable && !f->write_armed)
+			sp_uring_arm_write(u, sock, f);
+	}
+	u->rearm_n = 0;
+	unsigned submit = sp_uring_pending(u);
+	spinlock_unlock(&u->lock);
+
+	unsigned head = *u->cq_head;
+	if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+		// submit and wait in one syscall
+		if (sp_uring_enter(u, submit, 1) < 0) {
+			return -1;
+		}
+	} else if (submit) {
+		sp_uring_enter(u, submit, 0);
+	}
+
+	int n = 0;
+	spinlock_lock(&u->lock);
+	unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+	// keep a slot for each recycle buffer
+	while (head != tail && n < max && u->recycle_n < SP_URING_BUFFER_COUNT) {
+		struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+		++head;
+		if (sp_uring_event(u, cqe, &e[n])) {
+			++n;
+		} else if (e[n].buffer) {
+			// ignored, give the buffer back now
+			sp_uring_buffer_add(u, u->recycle[--u->recycle_n]);
+			sp_uring_buffer_commit(u);
+		}
+	}
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+	spinlock_unlock(&u->lock);
+	if (n == 0) {
+		errno = EINTR;
+		return -1;
+	}
+	return n;
+}
+
+static void
+sp_nonblocking(int fd) {
+	int flag = fcntl(fd, F_GETFL, 0);
+	if ( -1 == flag ) {
+		return;
+	}
+
+	fcntl(fd, F_SETFL, flag | O_NONBLOCK);
+}
+
+#endif
@@ -0,0 +1,88 @@
+local skynet = require "skynet"
+
+-- Launch and retire many agents while senders keep sending messages to the recent handles (alive or not).
+-- It stresses the handle storage (skynet_handle_grab vs register/retire).
+-- testchurn [agents] [senders]
+
+local mode, agents, senders = ...
+
+if mode == "agent" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, cmd)
+		if cmd == "exit" then
+			skynet.exit()
+		end
+	end)
+end)
+
+elseif mode == "sender" then
+
+local low, high
+local sent = 0
+local stop
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, cmd, l, h)
+		if cmd == "range" then
+			low, high = l, h
+		elseif cmd == "stop" then
+			stop = true
+			skynet.ret(skynet.pack(sent))
+		end
+	end)
+	skynet.fork(function()
+		while not stop do
+			while not low and not stop do
+				skynet.sleep(1)
+			end
+			if stop then
+				break
+			end
+			for i = 1, 100 do
+				skynet.send(math.random(low, high), "lua", "ping")
+			end
+			sent = sent + 100
+			skynet.sleep(0)
+		end
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local n = tonumber(mode) or 5000
+	local m = tonumber(agents) or 4
+	local s = {}
+	for i = 1, m do
+		s[i] = skynet.newservice(SERVICE_NAME, "sender")
+	end
+	local start = skynet.now()
+	local recent = {}
+	for i = 1, n do
+		local addr = skynet.newservice(SERVICE_NAME, "agent")
+		recent[#recent+1] = addr
+		if #recent == 16 then
+			for _, a in ipairs(recent) do
+				skynet.send(a, "lua", "exit")
+			end
+			for _, sender in ipairs(s) do
+				skynet.send(sender, "lua", "range", recent[1], addr)
+			end
+			recent = {}
+		end
+	end
+	for _, a in ipairs(recent) do
+		skynet.send(a, "lua", "exit")
+	end
+	local ti = skynet.now() - start
+	local sent = 0
+	for _, sender in ipairs(s) do
+		sent = sent + skynet.call(sender, "lua", "stop")
+	end
+	print(string.format("%d agents launched and retired in %.2fs (%d/sec), %d messages sent to them",
+		n, ti / 100, n * 100 // math.max(ti, 1), sent))
+	skynet.exit()
+end)
+
+end
@@ -0,0 +1,78 @@
+local skynet = require "skynet"
+
+-- Many senders flood one service, run it with different message queue implementations
+-- (see USE_LOCKFREE_MQ in Makefile) to compare the contention on the receiver's queue.
+-- It's a fan-in test as well : testcontention 1000 1000 , 1000 senders target one service.
+-- testcontention stress [senders] [count] : the senders yield after each message, so the receiver's queue
+-- becomes empty and is taken by another worker again and again. Run it with many worker threads.
+
+local mode, receiver, count = ...
+
+if mode == "receiver" then
+
+local total = 0
+local target
+local response
+
+skynet.start(function()
+	skynet.dispatch("lua", function(session, source, cmd, n)
+		if cmd == "wait" then
+			target = n
+			if total >= target then
+				skynet.ret()
+				skynet.exit()
+			else
+				response = skynet.response()
+			end
+		else
+			total = total + 1
+			if response and total == target then
+				response(true)
+				skynet.exit()
+			end
+		end
+	end)
+end)
+
+elseif mode == "sender" then
+
+skynet.start(function()
+	receiver = tonumber(receiver)
+	count = tonumber(count)
+	skynet.dispatch("lua", function(_,_, trickle)
+		for i = 1, count do
+			skynet.send(receiver, "lua", "push")
+			if trickle then
+				skynet.yield()
+			end
+		end
+		skynet.exit()
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local trickle = mode == "stress"
+	if trickle then
+		mode, receiver = receiver, count
+	end
+	local senders = tonumber(mode) or 100
+	local count = tonumber(receiver) or 10000
+	local r = skynet.newservice(SERVICE_NAME, "receiver")
+	local s = {}
+	for i = 1, senders do
+		s[i] = skynet.newservice(SERVICE_NAME, "sender", r, count)
+	end
+	local total = senders * count
+	local start = skynet.now()
+	for i = 1, senders do
+		skynet.send(s[i], "lua", trickle)
+	end
+	skynet.call(r, "lua", "wait", total)
+	local ti = skynet.now() - start
+	print(string.format("%d %ssenders send %d messages in %.2fs, %d msgs/sec", senders, trickle and "trickle " or "", total, ti / 100, total * 100 // math.max(ti, 1)))
+	skynet.exit()
+end)
+
+end
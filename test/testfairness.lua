@@ -0,0 +1,94 @@
+local skynet = require "skynet"
+
+-- A bulk service drains a big backlog while a light service answers calls.
+-- Compare the call latency (fairness) and the bulk throughput with different dispatch_budget in config.
+-- testfairness [backlog] [work]
+-- work is the loop count of each bulk message, use 0 for the handlers cheaper than 1us (the cost measured is 0).
+
+local mode, work = ...
+
+if mode == "bulk" then
+
+local done = 0
+local response
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, cmd, n)
+		if cmd == "work" then
+			local s = 0
+			for i = 1, n do
+				s = s + i
+			end
+			done = done + 1
+		else
+			-- wait
+			if done >= n then
+				skynet.ret()
+			else
+				response = skynet.response()
+				skynet.fork(function()
+					while done < n do
+						skynet.sleep(1)
+					end
+					response(true)
+				end)
+			end
+		end
+	end)
+end)
+
+elseif mode == "producer" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, bulk, n, work)
+		for i = 1, n do
+			skynet.send(bulk, "lua", "work", work)
+		end
+		skynet.call(bulk, "lua", "wait", n)
+		skynet.ret()
+	end)
+end)
+
+elseif mode == "light" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function()
+		skynet.ret()
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local backlog = tonumber(mode) or 50000
+	work = tonumber(work) or 1000
+	local bulk = skynet.newservice(SERVICE_NAME, "bulk")
+	local light = skynet.newservice(SERVICE_NAME, "light")
+	local producer = skynet.newservice(SERVICE_NAME, "producer")
+	local start
+	local finish = false
+	-- the backlog is sent when the light calls begin, so the first turn of the bulk (a new service) is measured too
+	skynet.fork(function()
+		start = skynet.now()
+		skynet.call(producer, "lua", bulk, backlog, work)
+		finish = skynet.now()
+	end)
+	local hpc = skynet.hpc
+	local t = {}
+	while not finish do
+		local s = hpc()
+		skynet.call(light, "lua")
+		t[#t+1] = hpc() - s
+		skynet.sleep(0)
+	end
+	table.sort(t)
+	local n = #t
+	local function us(p)
+		return t[math.max(1, math.floor(n * p))] // 1000
+	end
+	print(string.format("dispatch_budget = %s : bulk %d messages (work %d) in %.2fs, light call %d times p50 = %dus p99 = %dus max = %dus",
+		skynet.getenv "dispatch_budget", backlog, work, (finish - start) / 100, n, us(0.5), us(0.99), us(1)))
+	skynet.exit()
+end)
+
+end
@@ -0,0 +1,41 @@
+local skynet = require "skynet"
+require "skynet.manager"	-- import skynet.kill
+
+-- Measure the latency of skynet.call when the workers are idle (parked) between calls.
+
+local mode = ...
+
+if mode == "slave" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function()
+		skynet.ret()
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local slave = skynet.newservice(SERVICE_NAME, "slave")
+	local n = tonumber(mode) or 1000
+	local hpc = skynet.hpc
+	local t = {}
+	for i = 1, n do
+		skynet.sleep(0)
+		local start = hpc()
+		skynet.call(slave, "lua")
+		t[i] = hpc() - start
+		if i % 10 == 0 then
+			skynet.sleep(1)	-- let workers sleep
+		end
+	end
+	table.sort(t)
+	local function us(p)
+		return t[math.max(1, math.floor(n * p))] // 1000
+	end
+	print(string.format("call %d times, p50 = %dus p99 = %dus max = %dus", n, us(0.5), us(0.99), us(1)))
+	skynet.kill(slave)
+	skynet.exit()
+end)
+
+end
@@ -0,0 +1,80 @@
+local skynet = require "skynet"
+require "skynet.manager"	-- import skynet.name, skynet.kill
+
+-- Register many local names, then send by name (skynet_sendname resolves them).
+-- testname [names] [sends]
+
+local mode, names, sends = ...
+
+if mode == "sink" then
+
+local recv = 0
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, cmd)
+		if cmd == "sync" then
+			skynet.ret(skynet.pack(recv))
+			recv = 0
+		else
+			recv = recv + 1
+		end
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local n = tonumber(mode) or 100000
+	local m = tonumber(names) or 1000000
+	local hpc = skynet.hpc
+	local sinks = {}
+	for i = 1, 16 do
+		sinks[i] = skynet.newservice(SERVICE_NAME, "sink")
+	end
+	local function report(what, count, ti)
+		print(string.format("%s : %d in %.3fs, %d/sec", what, count, ti / 1e9, count * 1e9 // math.max(ti, 1)))
+	end
+	local function sync()
+		local total = 0
+		for _, addr in ipairs(sinks) do
+			total = total + skynet.call(addr, "lua", "sync")
+		end
+		return total
+	end
+
+	local s = hpc()
+	for i = 1, n do
+		skynet.name(".n" .. i, sinks[i % 16 + 1])
+	end
+	report("register names", n, hpc() - s)
+	assert(skynet.localname(".n1") == sinks[2])
+
+	local keys = {}
+	for i = 1, n do
+		keys[i] = ".n" .. i
+	end
+
+	s = hpc()
+	for i = 1, m do
+		skynet.send(keys[i % n + 1], "lua", "ping")
+	end
+	assert(sync() == m)
+	report("send to all names", m, hpc() - s)
+
+	s = hpc()
+	for i = 1, m do
+		skynet.send(keys[i % 8 + 1], "lua", "ping")
+	end
+	assert(sync() == m)
+	report("send to 8 names", m, hpc() - s)
+
+	s = hpc()
+	for _, addr in ipairs(sinks) do
+		skynet.kill(addr)
+	end
+	report("remove names", n, hpc() - s)
+	assert(skynet.localname(".n1") == nil)
+	skynet.exit()
+end)
+
+end
@@ -0,0 +1,76 @@
+local skynet = require "skynet"
+require "skynet.manager"	-- import skynet.priority
+
+-- Some bulk services drain their backlog while a light service answers calls.
+-- Run with the priority of the light service (high/normal/low) and compare the call latency.
+
+local mode, level = ...
+
+if mode == "bulk" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, n)
+		local s = 0
+		for i = 1, n do
+			s = s + i
+		end
+		if n == 0 then
+			skynet.ret()
+		end
+	end)
+end)
+
+elseif mode == "light" then
+
+skynet.start(function()
+	-- the first message is already scheduled at the launch priority
+	assert(skynet.priority() == level)
+	skynet.dispatch("lua", function()
+		skynet.ret()
+	end)
+end)
+
+else
+
+skynet.start(function()
+	level = mode or "high"
+	local light = skynet.newservice({ priority = level }, SERVICE_NAME, "light", level)
+	assert(skynet.priority(light) == level)
+	assert(skynet.priority() == "normal")
+	local bulk = {}
+	for i = 1, 8 do
+		bulk[i] = skynet.newservice({ priority = "low" }, SERVICE_NAME, "bulk")
+		assert(skynet.priority(bulk[i]) == "low")
+	end
+	local backlog = 10000
+	for _, addr in ipairs(bulk) do
+		for i = 1, backlog do
+			skynet.send(addr, "lua", 1000)
+		end
+	end
+	local finish = 0
+	for _, addr in ipairs(bulk) do
+		skynet.fork(function()
+			skynet.call(addr, "lua", 0)
+			finish = finish + 1
+		end)
+	end
+	local hpc = skynet.hpc
+	local t = {}
+	while finish < #bulk do
+		local s = hpc()
+		skynet.call(light, "lua")
+		t[#t+1] = hpc() - s
+		skynet.sleep(0)
+	end
+	table.sort(t)
+	local n = #t
+	local function us(p)
+		return t[math.max(1, math.floor(n * p))] // 1000
+	end
+	print(string.format("priority = %s : light call %d times p50 = %dus p99 = %dus max = %dus",
+		level, n, us(0.5), us(0.99), us(1)))
+	skynet.exit()
+end)
+
+end
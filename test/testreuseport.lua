@@ -0,0 +1,90 @@
+local skynet = require "skynet"
+local socket = require "skynet.socket"
+require "skynet.manager"	-- import skynet.launch, ...
+
+-- Listener group : the services listen on the same port (SO_REUSEPORT), and the kernel spreads the connections among them.
+-- The lua services use socket.listen(host, port, backlog, true), and the gate (service_gate.c) has a reuseport parm.
+-- testreuseport [members] [connections] [port]
+
+local mode, conns, port = ...
+
+if mode == "member" then
+
+skynet.start(function()
+	local accept = 0
+	local id
+	skynet.dispatch("lua", function(_,_, cmd, port)
+		if cmd == "listen" then
+			id = socket.listen("127.0.0.1", port, nil, true)
+			socket.start(id, function(fd)
+				accept = accept + 1
+				socket.close_fd(fd)
+			end)
+			skynet.ret()
+		else
+			socket.close(id)
+			skynet.ret(skynet.pack(accept))
+		end
+	end)
+end)
+
+else
+
+local function connect(port, m)
+	for i = 1, m do
+		local fd = assert(socket.open("127.0.0.1", port))
+		-- wait for the member to close it, so the connection is accepted
+		assert(socket.read(fd) == false)
+		socket.close(fd)
+	end
+end
+
+skynet.register_protocol {
+	name = "text",
+	id = skynet.PTYPE_TEXT,
+	pack = function(text) return text end,
+	unpack = skynet.tostring,
+}
+
+skynet.start(function()
+	local k = tonumber(mode) or 4
+	local m = tonumber(conns) or 1000
+	port = tonumber(port) or 8768
+
+	local member = {}
+	for i = 1, k do
+		member[i] = skynet.newservice(SERVICE_NAME, "member")
+		skynet.call(member[i], "lua", "listen", port)
+	end
+	connect(port, m)
+	local accept = {}
+	for i = 1, k do
+		accept[i] = skynet.call(member[i], "lua", "close")
+		skynet.send(member[i], "debug", "EXIT")
+	end
+	print(string.format("%d services accept %d connections : %s", k, m, table.concat(accept, " ")))
+
+	-- the gates report to this service as the watchdog, and it kicks the connections
+	local gate_accept = {}
+	skynet.dispatch("text", function(_, source, msg)
+		local fd, cmd = msg:match "(%d+) (%a+)"
+		if cmd == "open" then
+			gate_accept[source] = (gate_accept[source] or 0) + 1
+			skynet.send(source, "text", "kick " .. fd)
+		end
+	end)
+	skynet.register ".reuseport"
+	local gate = {}
+	for i = 1, k do
+		gate[i] = skynet.launch("gate", string.format("S .reuseport 127.0.0.1:%d 0 %d 1", port, m))
+	end
+	connect(port, m)
+	for i = 1, k do
+		gate_accept[i] = gate_accept[gate[i]] or 0
+		skynet.kill(gate[i])
+	end
+	print(string.format("%d gates accept %d connections : %s", k, m, table.concat(gate_accept, " ")))
+	skynet.exit()
+end)
+
+end
@@ -0,0 +1,60 @@
+local skynet = require "skynet"
+
+-- Many pairs of services bounce messages to each other, it measures the throughput of the scheduler.
+-- Run it with different thread counts and worksteal = true/false in config.
+
+local mode, pairs_n, count = ...
+
+if mode == "player" then
+
+local main = tonumber(pairs_n)
+local peer
+
+skynet.start(function()
+	skynet.dispatch("lua", function(session, source, cmd, n)
+		if cmd == "peer" then
+			peer = n
+		elseif n > 0 then
+			skynet.send(peer, "lua", "ping", n - 1)
+		else
+			skynet.send(main, "lua", "done")
+			skynet.exit()
+		end
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local n = tonumber(mode) or 100
+	local count = tonumber(pairs_n) or 10000
+	local players = {}
+	for i = 1, n * 2 do
+		players[i] = skynet.newservice(SERVICE_NAME, "player", skynet.self())
+	end
+	local done = 0
+	local co = coroutine.running()
+	skynet.dispatch("lua", function(_,_, cmd)
+		done = done + 1
+		if done == n then
+			skynet.wakeup(co)
+		end
+	end)
+	for i = 1, n do
+		local a, b = players[i * 2 - 1], players[i * 2]
+		skynet.send(a, "lua", "peer", b)
+		skynet.send(b, "lua", "peer", a)
+	end
+	local start = skynet.now()
+	for i = 1, n do
+		skynet.send(players[i * 2 - 1], "lua", "ping", count)
+	end
+	skynet.wait(co)
+	local ti = skynet.now() - start
+	local total = n * count
+	print(string.format("thread = %s, worksteal = %s : %d pairs bounce %d messages in %.2fs, %d msgs/sec",
+		skynet.getenv "thread", skynet.getenv "worksteal", n, total, ti / 100, total * 100 // math.max(ti, 1)))
+	skynet.exit()
+end)
+
+end
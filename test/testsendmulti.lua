@@ -0,0 +1,90 @@
+local skynet = require "skynet"
+require "skynet.manager"	-- import skynet.kill
+
+-- Broadcast one update to many agents, compare skynet.sendmulti (packed and allocated once) with skynet.send in a loop.
+-- testsendmulti [agents] [times]
+
+local mode, agents, times = ...
+
+if mode == "null" then
+
+-- No skynet.start, so the callback is NULL and the messages are dropped.
+
+elseif mode == "agent" then
+
+local recv = 0
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, cmd, update)
+		if cmd == "update" then
+			assert(#update.units == 16)
+			recv = recv + 1
+		else
+			skynet.ret(skynet.pack(recv))
+			recv = 0
+		end
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local n = tonumber(mode) or 5000
+	local times = tonumber(agents) or 10
+	local addrs = {}
+	for i = 1, n do
+		addrs[i] = skynet.newservice(SERVICE_NAME, "agent")
+	end
+	local update = { frame = 0, units = {} }
+	for i = 1, 16 do
+		update.units[i] = { id = i, x = i * 1.5, y = i * 2.5, hp = 100 }
+	end
+
+	local function sync()
+		for i = 1, n do
+			assert(skynet.call(addrs[i], "lua", "sync") == times)
+		end
+	end
+
+	local function bench(name, f)
+		local s = skynet.hpc()
+		for i = 1, times do
+			update.frame = i
+			f()
+		end
+		sync()
+		print(string.format("%s : %d agents x %d updates in %.3fs", name, n, times, (skynet.hpc() - s) / 1e9))
+	end
+
+	bench("send", function()
+		for i = 1, n do
+			skynet.send(addrs[i], "lua", "update", update)
+		end
+	end)
+	bench("sendmulti", function()
+		assert(skynet.sendmulti(addrs, "lua", "update", update) == n)
+	end)
+
+	-- The small (inline) messages and the shared buffer are dropped by a service without callback.
+	-- skynet.launch doesn't wait for skynet.start, as skynet.newservice does.
+	local null = skynet.launch("snlua", SERVICE_NAME, "null")
+	for i = 1, 1000 do
+		skynet.send(null, "lua", "sync")
+		skynet.send(null, "lua", "update", update)
+	end
+	addrs[n+1] = null
+	assert(skynet.sendmulti(addrs, "lua", "update", update) == n + 1)
+	addrs[n+1] = nil
+	for i = 1, n do
+		assert(skynet.call(addrs[i], "lua", "sync") == 1)
+	end
+	skynet.kill(null)
+	print("null callback : drop ok")
+
+	for i = 1, n do
+		skynet.kill(addrs[i])
+	end
+	skynet.exit()
+end)
+
+end
@@ -0,0 +1,36 @@
+local skynet = require "skynet"
+
+-- Measure skynet.sleep_ms/timeout_ms, run it with timer_resolution = 1 (millisecond ticks) and the default (10ms).
+-- testsleepms [times]
+
+local times = ...
+
+skynet.start(function()
+	times = tonumber(times) or 100
+	local hpc = skynet.hpc
+	for _, ms in ipairs { 1, 2, 5, 20 } do
+		local s = hpc()
+		for i = 1, times do
+			skynet.sleep_ms(ms)
+		end
+		local sleep = (hpc() - s) / times / 1e6
+		local fired = 0
+		s = hpc()
+		for i = 1, times do
+			skynet.timeout_ms(ms, function()
+				fired = fired + 1
+				if fired == times then
+					skynet.wakeup(times)
+				end
+			end)
+		end
+		skynet.wait(times)
+		print(string.format("sleep_ms(%d) : %.2fms , %d timeout_ms(%d) fired in %.2fms",
+			ms, sleep, times, ms, (hpc() - s) / 1e6))
+	end
+	-- centisecond api still works
+	local s = hpc()
+	skynet.sleep(5)
+	print(string.format("sleep(5) : %.2fms", (hpc() - s) / 1e6))
+	skynet.exit()
+end)
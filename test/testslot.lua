@@ -0,0 +1,36 @@
+local skynet = require "skynet"
+require "skynet.manager"	-- import skynet.launch, skynet.kill
+
+-- Launch a spike of temporary services (logger, it's cheap) and retire them, a few rounds.
+-- The handle slot table grows and shrinks step by step, see skynet.stat "slot" and "slotreclaim".
+-- testslot [services] [rounds]
+
+local n, rounds = ...
+
+skynet.start(function()
+	n = tonumber(n) or 100000
+	rounds = tonumber(rounds) or 2
+	local hpc = skynet.hpc
+	for r = 1, rounds do
+		local t = {}
+		local addrs = {}
+		for i = 1, n do
+			local s = hpc()
+			addrs[i] = skynet.launch("logger")
+			t[i] = hpc() - s
+		end
+		local peak = skynet.stat "slot"
+		table.sort(t)
+		local function us(p)
+			return t[math.max(1, math.floor(n * p))] / 1000
+		end
+		for i = 1, n do
+			skynet.kill(addrs[i])
+		end
+		-- the timer thread finishes shrinking
+		skynet.sleep(20)
+		print(string.format("round %d : launch %d services p50 = %.1fus p99 = %.1fus max = %.1fus, slot %d -> %d, %d bytes reclaimed",
+			r, n, us(0.5), us(0.99), us(1), peak, skynet.stat "slot", skynet.stat "slotreclaim"))
+	end
+	skynet.exit()
+end)
@@ -0,0 +1,105 @@
+local skynet = require "skynet"
+local socket = require "skynet.socket"
+local memory = require "skynet.memory"
+
+-- Loopback echo load : the clients send packets and wait for the echo on many connections.
+-- Compare the configs, ie. socket_thread = 1 and socket_thread = 4, or the build with -DUSE_IO_URING (or -DUSE_EPOLL_ET).
+-- testsocketload [connections] [packets per connection] [packet size] [services]
+
+local mode, packets, size, services = ...
+
+if mode == "echo" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, id)
+		skynet.fork(function()
+			socket.start(id)
+			while true do
+				local str = socket.read(id)
+				if not str then
+					break
+				end
+				socket.write(id, str)
+			end
+			socket.close(id)
+		end)
+	end)
+end)
+
+elseif mode == "client" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, port, n, m, sz)
+		local data = string.rep("x", sz)
+		local finish = 0
+		local co = coroutine.running()
+		for i = 1, n do
+			skynet.fork(function()
+				local id = assert(socket.open("127.0.0.1", port))
+				for j = 1, m do
+					socket.write(id, data)
+					assert(socket.read(id, sz) == data)
+				end
+				socket.close(id)
+				finish = finish + 1
+				if finish == n then
+					skynet.wakeup(co)
+				end
+			end)
+		end
+		skynet.wait(co)
+		skynet.ret()
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local n = tonumber(mode) or 1000
+	local m = tonumber(packets) or 100
+	local sz = tonumber(size) or 64
+	local k = tonumber(services) or 8
+	local echo = {}
+	for i = 1, k do
+		echo[i] = skynet.newservice(SERVICE_NAME, "echo")
+	end
+	local listen, _, port = socket.listen("127.0.0.1", 0, n)
+	local index = 0
+	socket.start(listen, function(id)
+		index = index % k + 1
+		skynet.send(echo[index], "lua", id)
+	end)
+	local client = {}
+	for i = 1, k do
+		client[i] = skynet.newservice(SERVICE_NAME, "client")
+	end
+	local s = skynet.hpc()
+	local finish = 0
+	local co = coroutine.running()
+	for i = 1, k do
+		skynet.fork(function()
+			-- the connections are divided among the clients
+			local c = n // k + (i <= n % k and 1 or 0)
+			skynet.call(client[i], "lua", port, c, m, sz)
+			finish = finish + 1
+			if finish == k then
+				skynet.wakeup(co)
+			end
+		end)
+	end
+	skynet.wait(co)
+	local ti = (skynet.hpc() - s) / 1e9
+	print(string.format("%d connections x %d packets (%d bytes) in %.2fs, %d packets/sec (socket_thread = %s)",
+		n, m, sz, ti, n * m // ti, skynet.getenv "socket_thread"))
+	local pool = memory.socketpool()
+	print(string.format("read buffer pool : %d buffers allocated (%d bytes), %d free, %d batches reused, %d batches released",
+		pool.buffer, pool.bytes, pool.free, pool.reuse, pool.release))
+	socket.close(listen)
+	for i = 1, k do
+		skynet.send(echo[i], "debug", "EXIT")
+		skynet.send(client[i], "debug", "EXIT")
+	end
+	skynet.exit()
+end)
+
+end
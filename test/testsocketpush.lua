@@ -0,0 +1,75 @@
+local skynet = require "skynet"
+local socket = require "skynet.socket"
+
+-- Fan-out push : many services push small packets to one connection, and the client doesn't read until they finish.
+-- So the packets queue in the write buffer lists and are flushed (by writev) when the client reads.
+-- testsocketpush [services] [packets per service] [packet size]
+
+local mode, packets, size = ...
+
+if mode == "push" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, id, m, sz)
+		local data = string.rep("x", sz)
+		for i = 1, m do
+			socket.write(id, data)
+		end
+		skynet.ret()
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local k = tonumber(mode) or 4
+	local m = tonumber(packets) or 100000
+	local sz = tonumber(size) or 32
+	local pusher = {}
+	for i = 1, k do
+		pusher[i] = skynet.newservice(SERVICE_NAME, "push")
+	end
+	local conn
+	local accept = {}
+	local listen, _, port = socket.listen("127.0.0.1", 0)
+	socket.start(listen, function(id)
+		conn = id
+		socket.start(id)
+		skynet.wakeup(accept)
+	end)
+	local client = assert(socket.open("127.0.0.1", port))
+	if not conn then
+		skynet.wait(accept)
+	end
+	local s = skynet.hpc()
+	local finish = 0
+	local co = {}
+	for i = 1, k do
+		skynet.fork(function()
+			skynet.call(pusher[i], "lua", conn, m, sz)
+			finish = finish + 1
+			if finish == k then
+				skynet.wakeup(co)
+			end
+		end)
+	end
+	skynet.wait(co)
+	local push = skynet.hpc() - s
+	local total = k * m * sz
+	local recv = 0
+	while recv < total do
+		recv = recv + #assert(socket.read(client))
+	end
+	local ti = (skynet.hpc() - s) / 1e9
+	print(string.format("%d services push %d x %d bytes, queued in %.2fs, all received in %.2fs (%.1f MB/s)",
+		k, m, sz, push / 1e9, ti, total / ti / 1e6))
+	socket.close(client)
+	socket.close(conn)
+	socket.close(listen)
+	for i = 1, k do
+		skynet.send(pusher[i], "debug", "EXIT")
+	end
+	skynet.exit()
+end)
+
+end
@@ -0,0 +1,51 @@
+local skynet = require "skynet"
+
+-- Set many deadlines (sleep with a token, or timeout) and clear them before they fire.
+-- The timers are removed by skynet_timeout_cancel, so the service doesn't receive the dead wakeups.
+-- testtimercancel [deadlines]
+
+local n = ...
+
+skynet.start(function()
+	n = tonumber(n) or 10000
+	local tokens = {}
+	local finish = 0
+	for i = 1, n do
+		local token = {}
+		tokens[i] = token
+		skynet.fork(function()
+			if skynet.sleep(100, token) == "BREAK" then
+				finish = finish + 1
+			end
+		end)
+	end
+	local threads = {}
+	for i = 1, 100 do
+		threads[i] = skynet.timeout(100, function()
+			error "timeout should be killed"
+		end)
+	end
+	-- timeout 0 responds at once, so the cancel misses and the response is dropped by the tombstone
+	skynet.killthread(skynet.timeout(0, function()
+		error "timeout should be killed"
+	end))
+	skynet.yield()
+	local message = skynet.stat "message"
+	local s = skynet.hpc()
+	for i = 1, n do
+		skynet.wakeup(tokens[i])
+	end
+	for i = 1, 100 do
+		skynet.killthread(threads[i])
+	end
+	skynet.yield()
+	assert(finish == n)
+	local ti = skynet.hpc() - s
+	skynet.sleep(110)
+	-- 2 : the yield and the sleep above
+	local dead = skynet.stat "message" - message - 2
+	print(string.format("clear %d deadlines in %.3fs, %d messages received after them",
+		n, ti / 1e9, dead))
+	assert(dead == 0)
+	skynet.exit()
+end)
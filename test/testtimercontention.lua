@@ -0,0 +1,120 @@
+local skynet = require "skynet"
+local c = require "skynet.core"
+local memory = require "skynet.memory"
+
+-- Many services submit timeouts at the same time, run it with thread = 32 to see the contention on the timer.
+-- The timeouts are submitted by the TIMEOUT command directly, and counted by the unknown response handler.
+-- The order agent checks that the timeouts of the same time fire in the order they are submitted,
+-- even if the service moves between the worker threads.
+-- testtimercontention [services] [timeouts]
+
+local mode, count = ...
+
+if mode == "agent" then
+
+local recv = 0
+local total
+local response
+
+skynet.start(function()
+	skynet.dispatch_unknown_response(function()
+		recv = recv + 1
+		if recv == total and response then
+			response(true, recv)
+		end
+	end)
+	skynet.dispatch("lua", function(_,_, n)
+		total = n
+		local s = skynet.hpc()
+		for i = 1, n do
+			c.intcommand("TIMEOUT", i % 100 + 1)
+		end
+		local ti = skynet.hpc() - s
+		if recv == total then
+			skynet.ret(skynet.pack(ti))
+		else
+			local r = skynet.response()
+			response = function()
+				r(true, ti)
+			end
+		end
+	end)
+end)
+
+elseif mode == "order" then
+
+skynet.start(function()
+	local last = 0
+	local recv = 0
+	local response
+	skynet.dispatch_unknown_response(function(session)
+		assert(session > last, "timeout out of order")
+		last = session
+		recv = recv + 1
+		if recv == count then
+			response(true, recv)
+		end
+	end)
+	skynet.dispatch("lua", function(_,_, n)
+		count = n
+		response = skynet.response()
+		for i = 1, n do
+			c.intcommand("TIMEOUT", 1)
+			if i % 16 == 0 then
+				skynet.yield()
+			end
+		end
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local n = tonumber(mode) or 32
+	local m = tonumber(count) or 100000
+	local agents = {}
+	for i = 1, n do
+		agents[i] = skynet.newservice(SERVICE_NAME, "agent")
+	end
+	local s = skynet.hpc()
+	local cost = 0
+	local finish = 0
+	for i = 1, n do
+		skynet.fork(function()
+			cost = cost + skynet.call(agents[i], "lua", m)
+			finish = finish + 1
+			if finish == n then
+				skynet.wakeup(agents)
+			end
+		end)
+	end
+	skynet.wait(agents)
+	local ti = skynet.hpc() - s
+	print(string.format("%d services submit %d timeouts, %d/sec per service, all fired in %.2fs",
+		n, n * m, m * n * 1e9 // math.max(cost, 1), ti / 1e9))
+	local order = {}
+	for i = 1, n do
+		order[i] = skynet.newservice(SERVICE_NAME, "order")
+	end
+	for i = 1, n do
+		skynet.fork(function()
+			skynet.call(order[i], "lua", 10000)
+			finish = finish + 1
+			if finish == n * 2 then
+				skynet.wakeup(order)
+			end
+		end)
+	end
+	skynet.wait(order)
+	print(string.format("%d services submit %d timeouts in order, all fired in order", n, n * 10000))
+	local pool = memory.timerpool()
+	print(string.format("timer pool : %d/%d nodes free (%d bytes), %d batches reused, %d batches released",
+		pool.free, pool.node, pool.bytes, pool.reuse, pool.release))
+	for i = 1, n do
+		skynet.send(agents[i], "debug", "EXIT")
+		skynet.send(order[i], "debug", "EXIT")
+	end
+	skynet.exit()
+end)
+
+end
@@ -0,0 +1,44 @@
+local skynet = require "skynet"
+
+-- Run it with timer_idle = true, and compare the context switches of the idle process with the default.
+-- testtimeridle [idle seconds]
+
+local seconds = ...
+
+-- voluntary context switches of all the threads (linux only)
+local function switches()
+	local f = io.open "/proc/self/stat"
+	if not f then
+		return 0
+	end
+	local pid = f:read "n"
+	f:close()
+	local n = 0
+	local tasks = io.popen("ls /proc/" .. pid .. "/task")
+	for tid in tasks:lines() do
+		local f = io.open("/proc/" .. pid .. "/task/" .. tid .. "/status")
+		if f then
+			n = n + (tonumber(f:read "a":match "\nvoluntary_ctxt_switches:%s*(%d+)") or 0)
+			f:close()
+		end
+	end
+	tasks:close()
+	return n
+end
+
+skynet.start(function()
+	seconds = tonumber(seconds) or 5
+	local hpc = skynet.hpc
+	-- timers still fire on time when the timer thread sleeps
+	for _, ti in ipairs { 1, 5, 50, 120 } do
+		local s = hpc()
+		local now = skynet.now()
+		skynet.sleep(ti)
+		print(string.format("sleep(%d) : %.2fms, now() + %d", ti, (hpc() - s) / 1e6, skynet.now() - now))
+	end
+	local n = switches()
+	skynet.sleep(seconds * 100)
+	print(string.format("idle %ds : %d context switches (timer_idle = %s)",
+		seconds, switches() - n, skynet.getenv "timer_idle"))
+	skynet.exit()
+end)
@@ -0,0 +1,104 @@
+local skynet = require "skynet"
+local socket = require "skynet.socket"
+
+-- Loopback udp echo load : each client sends the datagrams in windows and waits for the echo.
+-- The server socket reads the datagrams in batches (recvmmsg), and flushes the queued writes by sendmmsg.
+-- testudpload [clients] [datagrams per client] [datagram size] [window] [port]
+
+local mode, packets, size, window, port = ...
+
+if mode == "server" then
+
+skynet.start(function()
+	local host
+	host = socket.udp(function(str, from)
+		socket.sendto(host, from, str)
+	end, "127.0.0.1", tonumber(packets))
+	skynet.dispatch("lua", function()
+		socket.close(host)
+		skynet.ret()
+	end)
+end)
+
+elseif mode == "client" then
+
+skynet.start(function()
+	skynet.dispatch("lua", function(_,_, port, m, sz, w)
+		local data = string.rep("x", sz)
+		local recv = 0
+		local expect = 0
+		local token
+		local function wakeup(t)
+			if token == t then
+				token = nil
+				skynet.wakeup(t)
+			end
+		end
+		local c = socket.udp(function(str)
+			recv = recv + 1
+			if recv >= expect then
+				wakeup(token)
+			end
+		end)
+		socket.udp_connect(c, "127.0.0.1", port)
+		local sent = 0
+		while sent < m do
+			local n = math.min(w, m - sent)
+			for i = 1, n do
+				socket.write(c, data)
+			end
+			sent = sent + n
+			expect = sent
+			if recv < expect then
+				-- the datagrams may be lost
+				local t = {}
+				token = t
+				skynet.timeout(10, function() wakeup(t) end)
+				skynet.wait(t)
+			end
+		end
+		socket.close(c)
+		skynet.ret(skynet.pack(recv))
+	end)
+end)
+
+else
+
+skynet.start(function()
+	local k = tonumber(mode) or 8
+	local m = tonumber(packets) or 10000
+	local sz = tonumber(size) or 64
+	local w = tonumber(window) or 16
+	port = tonumber(port) or 8767
+	local server = skynet.newservice(SERVICE_NAME, "server", port)
+	local client = {}
+	for i = 1, k do
+		client[i] = skynet.newservice(SERVICE_NAME, "client")
+	end
+	local s = skynet.hpc()
+	local finish = 0
+	local recv = 0
+	local co = coroutine.running()
+	for i = 1, k do
+		skynet.fork(function()
+			local n = skynet.call(client[i], "lua", port, m, sz, w)
+			recv = recv + n
+			finish = finish + 1
+			if finish == k then
+				skynet.wakeup(co)
+			end
+		end)
+	end
+	skynet.wait(co)
+	local ti = (skynet.hpc() - s) / 1e9
+	print(string.format("%d clients x %d datagrams (%d bytes) in %.2fs, %d echoes/sec, %d lost",
+		k, m, sz, ti, recv // ti, k * m - recv))
+	skynet.call(server, "lua")
+	for i = 1, k do
+		skynet.send(client[i], "debug", "EXIT")
+	end
+	skynet.send(server, "debug", "EXIT")
+	skynet.exit()
+end)
+
+end